@@ -0,0 +1,623 @@
+//
+//  bps.cpp
+//  poketext-gen4
+//
+
+#include "bps.hpp"
+
+#include "byte_order.hpp"
+#include "checksum.hpp"
+#include "parallel.hpp"
+#include "perf_counters.hpp"
+#include "suffix_array.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <stdexcept>
+
+namespace bps {
+
+namespace {
+
+enum Action : uint64_t {
+    SourceRead = 0,
+    TargetRead = 1,
+    SourceCopy = 2,
+    TargetCopy = 3,
+};
+
+// Shorter matches cost more to encode than the literal bytes they replace.
+constexpr size_t kMinMatch = 8;
+// Anchors are hashes of kAnchorSize-byte windows of the source, kept where
+// the hash's top kAnchorBits bits are zero (about one window in 64). The
+// choice depends only on content, so the target picks the same windows and
+// only has to look those up. A shared run of kAnchorSize + 64 bytes or so
+// is found wherever it moved to.
+constexpr size_t kAnchorSize = 64;
+constexpr int kAnchorBits = 6;
+// Source slice hashed per parallel_for task while building anchors.
+constexpr size_t kAnchorSlice = 1024 * 1024;
+// Literal runs up to this size are rechecked against a suffix array over
+// the source around them, for the short reused strings anchors are too
+// coarse for. Longer runs are new data and stay literal.
+constexpr size_t kMaxRefine = 64 * 1024;
+// Source bytes taken on each side of a literal run for that suffix array.
+constexpr size_t kRefineMargin = 1024;
+// Upper bound on the source bytes indexed by the suffix array.
+constexpr size_t kIndexBudget = 1024 * 1024;
+// Literal positions are probed every kProbeStride bytes and matches are
+// extended backwards, so matches of kMinMatch + kProbeStride - 1 bytes or
+// more are always found.
+constexpr size_t kProbeStride = 4;
+// Bytes compared per suffix array probe.
+constexpr size_t kMaxProbe = 4096;
+
+size_t common_prefix(const uint8_t* a, const uint8_t* b, size_t n) {
+    size_t i = 0;
+    while (i + 8 <= n) {
+        uint64_t x, y;
+        std::memcpy(&x, a + i, 8);
+        std::memcpy(&y, b + i, 8);
+        if (x != y) break;
+        i += 8;
+    }
+    while (i < n && a[i] == b[i]) i++;
+    return i;
+}
+
+void put_number(std::vector<uint8_t>& out, uint64_t data) {
+    while (true) {
+        uint8_t x = data & 0x7F;
+        data >>= 7;
+        if (data == 0) {
+            out.push_back(0x80 | x);
+            break;
+        }
+        out.push_back(x);
+        data--;
+    }
+}
+
+constexpr uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+}
+
+struct GearTable {
+    uint64_t values[256] = {};
+    
+    constexpr GearTable() {
+        uint64_t state = 0;
+        for (uint64_t& v : values) v = splitmix64(state);
+    }
+};
+
+constexpr GearTable kGear;
+
+// Gear hash: each byte shifts the hash left and adds a random value for
+// the byte, so a byte's contribution is gone 64 bytes later and the hash
+// covers exactly the last kAnchorSize bytes, for one shift and one add.
+class RollingHash {
+public:
+    static_assert(kAnchorSize == 64, "the window is the width of the hash");
+    
+    // Hash of the window starting at `p`.
+    static uint64_t of(const uint8_t* p) {
+        uint64_t h = 0;
+        for (size_t i = 0; i < kAnchorSize; i++) h = roll(h, p[i]);
+        return h;
+    }
+    
+    // Hash of the window one byte further on, given the byte entering it.
+    static uint64_t roll(uint64_t h, uint8_t in) {
+        return (h << 1) + kGear.values[in];
+    }
+    
+    static bool is_anchor(uint64_t h) {
+        return (h >> (64 - kAnchorBits)) == 0;
+    }
+};
+
+// Source offsets of the anchor windows, in an open-addressing table of
+// (hash tag, offset + 1) pairs. Windows with the same hash keep the first
+// offset. Offsets past 4 GB are not indexed.
+class AnchorIndex {
+public:
+    static constexpr size_t npos = SIZE_MAX;
+    
+    AnchorIndex(const uint8_t* source, size_t source_size) {
+        perf::Stage stage("anchors", source_size);
+        const size_t windows = source_size >= kAnchorSize ? source_size - kAnchorSize + 1 : 0;
+        const size_t slices = (windows + kAnchorSlice - 1) / kAnchorSlice;
+        std::vector<std::vector<std::pair<uint64_t, uint32_t>>> found(slices);
+        parallel_for(slices, [&](size_t s) {
+            const size_t begin = s * kAnchorSlice;
+            const size_t end = std::min(windows, begin + kAnchorSlice);
+            if (end > UINT32_MAX - 1) return;
+            uint64_t h = RollingHash::of(source + begin);
+            for (size_t p = begin;; p++) {
+                if (RollingHash::is_anchor(h)) found[s].push_back({h, static_cast<uint32_t>(p)});
+                if (p + 1 == end) break;
+                h = RollingHash::roll(h, source[p + kAnchorSize]);
+            }
+        });
+        size_t count = 0;
+        for (const auto& f : found) count += f.size();
+        size_t capacity = 16;
+        while (capacity < count * 2) capacity *= 2;
+        mask_ = capacity - 1;
+        slots_.assign(capacity, Slot{0, 0});
+        for (const auto& f : found) {
+            for (auto [h, offset] : f) insert(h, offset);
+        }
+    }
+    
+    size_t find(uint64_t h) const {
+        const uint64_t m = mix(h);
+        const uint32_t tag = static_cast<uint32_t>(m >> 32);
+        for (size_t i = m & mask_;; i = (i + 1) & mask_) {
+            const Slot& slot = slots_[i];
+            if (slot.offset == 0) return npos;
+            if (slot.tag == tag) return slot.offset - 1;
+        }
+    }
+    
+private:
+    struct Slot {
+        uint32_t tag;
+        uint32_t offset;
+    };
+    
+    // Anchor hashes all have their top bits clear; spread them before
+    // picking a slot.
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCD;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53;
+        return h ^ (h >> 33);
+    }
+    
+    void insert(uint64_t h, uint32_t offset) {
+        const uint64_t m = mix(h);
+        const uint32_t tag = static_cast<uint32_t>(m >> 32);
+        for (size_t i = m & mask_;; i = (i + 1) & mask_) {
+            Slot& slot = slots_[i];
+            if (slot.offset == 0) {
+                slot = {tag, offset + 1};
+                return;
+            }
+            if (slot.tag == tag) return;
+        }
+    }
+    
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+};
+
+// Suffix array over a few source ranges, concatenated. Matches are
+// verified and extended against the full source, so range boundaries only
+// limit what can be found, not what is emitted.
+class SourceIndex {
+public:
+    // `ranges` are sorted, disjoint [begin, end) source ranges.
+    SourceIndex(const uint8_t* source, size_t source_size,
+                const std::vector<std::pair<size_t, size_t>>& ranges)
+        : source_(source), source_size_(source_size) {
+        size_t bytes = 0;
+        for (auto [begin, end] : ranges) bytes += end - begin;
+        perf::Stage stage("index", bytes);
+        text_.reserve(bytes);
+        for (auto [begin, end] : ranges) {
+            windows_.push_back({text_.size(), begin});
+            text_.insert(text_.end(), source + begin, source + end);
+        }
+        suffixes_ = build_suffix_array(text_.data(), text_.size());
+    }
+    
+    // Longest source match for `needle`, as (offset, length).
+    std::pair<size_t, size_t> longest_match(const uint8_t* needle, size_t needle_size) const {
+        if (suffixes_.empty()) return {0, 0};
+        const size_t probe = std::min(needle_size, kMaxProbe);
+        auto compare = [&](int32_t pos) {
+            size_t avail = text_.size() - pos;
+            size_t n = std::min(avail, probe);
+            int c = std::memcmp(text_.data() + pos, needle, n);
+            if (c != 0) return c;
+            return n < probe ? -1 : 0;
+        };
+        size_t lo = 0, hi = suffixes_.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (compare(suffixes_[mid]) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        std::pair<size_t, size_t> best{0, 0};
+        for (size_t i : {lo, lo - 1}) {
+            if (i >= suffixes_.size()) continue;
+            size_t offset = to_source(suffixes_[i]);
+            size_t len = common_prefix(source_ + offset, needle,
+                                       std::min(source_size_ - offset, needle_size));
+            if (len > best.second) best = {offset, len};
+        }
+        return best;
+    }
+    
+private:
+    struct Window {
+        size_t text_begin;
+        size_t source_begin;
+    };
+    
+    size_t to_source(size_t text_pos) const {
+        auto it = std::upper_bound(windows_.begin(), windows_.end(), text_pos,
+                                   [](size_t p, const Window& w) { return p < w.text_begin; });
+        --it;
+        return it->source_begin + (text_pos - it->text_begin);
+    }
+    
+    const uint8_t* source_;
+    size_t source_size_;
+    std::vector<uint8_t> text_;
+    std::vector<Window> windows_;
+    std::vector<int32_t> suffixes_;
+};
+
+// One step of the patch: `length` target bytes at `target`, copied from
+// `source` or, for literals, stored in the patch. Literals remember the
+// shift in effect where they start, to know where their old text was.
+struct Op {
+    size_t target;
+    size_t length;
+    size_t source;
+    bool literal;
+    int64_t shift;
+};
+
+class Encoder {
+public:
+    Encoder(std::vector<uint8_t>& out, const uint8_t* target) : out_(out), target_(target) {}
+    
+    void literal(size_t pos, size_t length) {
+        if (literal_size_ == 0) literal_begin_ = pos;
+        literal_size_ += length;
+    }
+    
+    void source_read(size_t length) {
+        flush();
+        action(SourceRead, length);
+    }
+    
+    void source_copy(size_t offset, size_t length) {
+        flush();
+        action(SourceCopy, length);
+        int64_t delta = static_cast<int64_t>(offset) - static_cast<int64_t>(source_relative_);
+        put_number(out_, (static_cast<uint64_t>(delta < 0 ? -delta : delta) << 1) | (delta < 0));
+        source_relative_ = offset + length;
+    }
+    
+    void flush() {
+        if (literal_size_ == 0) return;
+        action(TargetRead, literal_size_);
+        out_.insert(out_.end(), target_ + literal_begin_, target_ + literal_begin_ + literal_size_);
+        literal_size_ = 0;
+    }
+    
+private:
+    void action(Action a, size_t length) {
+        put_number(out_, (static_cast<uint64_t>(length - 1) << 2) | a);
+    }
+    
+    std::vector<uint8_t>& out_;
+    const uint8_t* target_;
+    size_t literal_begin_ = 0;
+    size_t literal_size_ = 0;
+    size_t source_relative_ = 0;
+};
+
+// Splits the target into copies and literals. Copies continue at the same
+// offset or at the shift of the previous copy for as long as they can;
+// when both stop matching, the target is scanned for the next point where
+// either resumes or an anchor lines up with the source, and everything in
+// between becomes a literal.
+class Matcher {
+public:
+    Matcher(const uint8_t* source, size_t source_size, const uint8_t* target, size_t target_size)
+        : source_(source), source_size_(source_size), target_(target), target_size_(target_size) {}
+    
+    std::vector<Op> run() {
+        size_t pos = 0;
+        while (pos < target_size_) {
+            size_t run = match_at(pos, 0);
+            if (run >= kMinMatch || (run > 0 && run == target_size_ - pos)) {
+                copy(pos, pos, run);
+                pos += run;
+                continue;
+            }
+            if (shift_ != 0 && (run = match_at(pos, shift_)) >= kMinMatch) {
+                copy(pos, pos + shift_, run);
+                pos += run;
+                continue;
+            }
+            pos = resync(pos);
+        }
+        return std::move(ops_);
+    }
+    
+private:
+    // Length of the match between target[pos...] and source[pos + shift...].
+    size_t match_at(size_t pos, int64_t shift) const {
+        const int64_t from = static_cast<int64_t>(pos) + shift;
+        if (from < 0 || static_cast<size_t>(from) >= source_size_) return 0;
+        return common_prefix(source_ + from, target_ + pos,
+                             std::min(source_size_ - from, target_size_ - pos));
+    }
+    
+    // Whether match_at(pos, shift) >= kMinMatch, without measuring the run.
+    bool lines_up(size_t pos, int64_t shift) const {
+        static_assert(kMinMatch == sizeof(uint64_t), "compared as one word");
+        const int64_t from = static_cast<int64_t>(pos) + shift;
+        if (from < 0 || static_cast<size_t>(from) + kMinMatch > source_size_
+            || pos + kMinMatch > target_size_) return false;
+        uint64_t x, y;
+        std::memcpy(&x, source_ + from, 8);
+        std::memcpy(&y, target_ + pos, 8);
+        return x == y;
+    }
+    
+    void copy(size_t pos, size_t from, size_t length) {
+        ops_.push_back({pos, length, from, false, 0});
+    }
+    
+    // Emits the literal starting at `begin` and the copy that ends it, and
+    // returns the target position after them.
+    size_t resync(size_t begin) {
+        if (!anchors_) anchors_ = std::make_unique<AnchorIndex>(source_, source_size_);
+        uint64_t h = 0;
+        for (size_t pos = begin; pos < target_size_; pos++) {
+            if (pos > begin && (lines_up(pos, 0) || (shift_ != 0 && lines_up(pos, shift_)))) {
+                literal(begin, pos);
+                return pos;
+            }
+            if (pos + kAnchorSize > target_size_) continue;
+            h = pos == begin ? RollingHash::of(target_ + pos)
+                             : RollingHash::roll(h, target_[pos + kAnchorSize - 1]);
+            if (!RollingHash::is_anchor(h)) continue;
+            size_t from = anchors_->find(h);
+            if (from == AnchorIndex::npos
+                || std::memcmp(source_ + from, target_ + pos, kAnchorSize) != 0) continue;
+            size_t back = 0;
+            while (pos - back > begin && from - back > 0
+                   && source_[from - back - 1] == target_[pos - back - 1]) back++;
+            const size_t length = back + match_at(pos, static_cast<int64_t>(from) - static_cast<int64_t>(pos));
+            literal(begin, pos - back);
+            copy(pos - back, from - back, length);
+            shift_ = static_cast<int64_t>(from) - static_cast<int64_t>(pos);
+            return pos - back + length;
+        }
+        literal(begin, target_size_);
+        return target_size_;
+    }
+    
+    void literal(size_t begin, size_t end) {
+        if (begin < end) ops_.push_back({begin, end - begin, 0, true, shift_});
+    }
+    
+    const uint8_t* source_;
+    size_t source_size_;
+    const uint8_t* target_;
+    size_t target_size_;
+    // Source offset minus target offset of the last relocated copy;
+    // relocated data tends to keep moving by the same amount.
+    int64_t shift_ = 0;
+    std::unique_ptr<AnchorIndex> anchors_;
+    std::vector<Op> ops_;
+};
+
+// Rechecks short literal runs against the source text around where they
+// used to be, so a rewritten string that keeps part of its old text copies
+// that part. Runs are probed every kProbeStride bytes.
+std::vector<Op> refine(const std::vector<Op>& ops, const uint8_t* source, size_t source_size,
+                       const uint8_t* target) {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    size_t indexed = 0;
+    for (const Op& op : ops) {
+        if (!op.literal || op.length > kMaxRefine) continue;
+        const int64_t at = static_cast<int64_t>(op.target) + op.shift;
+        const int64_t lo = std::max<int64_t>(0, at - static_cast<int64_t>(kRefineMargin));
+        const int64_t hi = std::min<int64_t>(static_cast<int64_t>(source_size),
+                                             at + static_cast<int64_t>(op.length + kRefineMargin));
+        if (lo >= hi) continue;
+        if (indexed + (hi - lo) > kIndexBudget) break;
+        ranges.push_back({static_cast<size_t>(lo), static_cast<size_t>(hi)});
+        indexed += hi - lo;
+    }
+    if (ranges.empty()) return ops;
+    std::sort(ranges.begin(), ranges.end());
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].first <= ranges[merged].second) {
+            ranges[merged].second = std::max(ranges[merged].second, ranges[i].second);
+        } else {
+            ranges[++merged] = ranges[i];
+        }
+    }
+    ranges.resize(merged + 1);
+    const SourceIndex index(source, source_size, ranges);
+    
+    std::vector<Op> out;
+    out.reserve(ops.size());
+    for (const Op& op : ops) {
+        if (!op.literal || op.length > kMaxRefine) {
+            out.push_back(op);
+            continue;
+        }
+        const size_t end = op.target + op.length;
+        size_t literal_begin = op.target;
+        size_t pos = op.target;
+        while (pos < end) {
+            auto [offset, length] = index.longest_match(target + pos, end - pos);
+            if (length < kMinMatch) {
+                pos += kProbeStride;
+                continue;
+            }
+            size_t back = 0;
+            while (pos - back > literal_begin && offset - back > 0
+                   && source[offset - back - 1] == target[pos - back - 1]) back++;
+            if (pos - back > literal_begin) {
+                out.push_back({literal_begin, pos - back - literal_begin, 0, true, op.shift});
+            }
+            out.push_back({pos - back, length + back, offset - back, false, 0});
+            pos += length;
+            literal_begin = pos;
+        }
+        if (literal_begin < end) out.push_back({literal_begin, end - literal_begin, 0, true, op.shift});
+    }
+    return out;
+}
+
+} // namespace
+
+std::vector<uint8_t> create(const uint8_t* source, size_t source_size,
+                            const uint8_t* target, size_t target_size,
+                            const std::string& metadata) {
+    perf::Stage stage("diff", source_size + target_size);
+    auto source_crc = std::async(std::launch::async, [=] { return crc32(source, source_size); });
+    auto target_crc = std::async(std::launch::async, [=] { return crc32(target, target_size); });
+    
+    std::vector<uint8_t> out = {'B', 'P', 'S', '1'};
+    put_number(out, source_size);
+    put_number(out, target_size);
+    put_number(out, metadata.size());
+    out.insert(out.end(), metadata.begin(), metadata.end());
+    
+    const std::vector<Op> ops = refine(Matcher(source, source_size, target, target_size).run(),
+                                       source, source_size, target);
+    Encoder encoder(out, target);
+    for (const Op& op : ops) {
+        if (op.literal) {
+            encoder.literal(op.target, op.length);
+        } else if (op.source == op.target) {
+            encoder.source_read(op.length);
+        } else {
+            encoder.source_copy(op.source, op.length);
+        }
+    }
+    encoder.flush();
+    
+    put_le(out, source_crc.get(), 4);
+    put_le(out, target_crc.get(), 4);
+    put_le(out, crc32(out.data(), out.size()), 4);
+    return out;
+}
+
+std::vector<uint8_t> apply(const uint8_t* source, size_t source_size,
+                           const uint8_t* patch, size_t patch_size) {
+    perf::Stage stage("apply", source_size + patch_size);
+    if (patch_size < 4 + 3 + 12 || std::memcmp(patch, "BPS1", 4) != 0) {
+        throw std::runtime_error("bps: not a BPS patch");
+    }
+    const size_t footer = patch_size - 12;
+    if (crc32(patch, patch_size - 4) != read_le32(patch + patch_size - 4)) {
+        throw std::runtime_error("bps: patch checksum mismatch");
+    }
+    
+    size_t p = 4;
+    auto get_number = [&]() {
+        uint64_t data = 0, shift = 1;
+        while (true) {
+            if (p >= footer) throw std::runtime_error("bps: truncated patch");
+            uint8_t x = patch[p++];
+            data += (x & 0x7F) * shift;
+            if (x & 0x80) break;
+            shift <<= 7;
+            data += shift;
+        }
+        return data;
+    };
+    
+    const uint64_t expected_source = get_number();
+    const uint64_t target_size = get_number();
+    const uint64_t metadata_size = get_number();
+    if (expected_source != source_size) {
+        throw std::runtime_error("bps: source size mismatch");
+    }
+    if (metadata_size > footer - p) {
+        throw std::runtime_error("bps: truncated patch");
+    }
+    p += metadata_size;
+    
+    auto source_crc = std::async(std::launch::async, [=] { return crc32(source, source_size); });
+    
+    std::vector<uint8_t> target(target_size);
+    uint8_t* out = target.data();
+    size_t output_offset = 0;
+    size_t source_relative = 0;
+    size_t target_relative = 0;
+    uint32_t target_crc = 0;
+    
+    auto relative = [&](size_t& base, size_t limit, size_t length) {
+        uint64_t data = get_number();
+        int64_t delta = static_cast<int64_t>(data >> 1) * ((data & 1) ? -1 : 1);
+        int64_t at = static_cast<int64_t>(base) + delta;
+        if (at < 0 || static_cast<uint64_t>(at) + length > limit) {
+            throw std::runtime_error("bps: copy out of range");
+        }
+        base = static_cast<size_t>(at);
+    };
+    
+    while (p < footer) {
+        const uint64_t data = get_number();
+        const size_t length = static_cast<size_t>(data >> 2) + 1;
+        if (length > target_size - output_offset) {
+            throw std::runtime_error("bps: action overruns target");
+        }
+        switch (data & 3) {
+        case SourceRead:
+            if (output_offset + length > source_size) {
+                throw std::runtime_error("bps: source read out of range");
+            }
+            std::memcpy(out + output_offset, source + output_offset, length);
+            break;
+        case TargetRead:
+            if (length > footer - p) throw std::runtime_error("bps: truncated patch");
+            std::memcpy(out + output_offset, patch + p, length);
+            p += length;
+            break;
+        case SourceCopy:
+            relative(source_relative, source_size, length);
+            std::memcpy(out + output_offset, source + source_relative, length);
+            source_relative += length;
+            break;
+        case TargetCopy:
+            relative(target_relative, output_offset, 1);
+            // May overlap the bytes being written (run-length style), so copy forward.
+            for (size_t i = 0; i < length; i++) {
+                out[output_offset + i] = out[target_relative++];
+            }
+            break;
+        }
+        target_crc = crc32(out + output_offset, length, target_crc);
+        output_offset += length;
+    }
+    
+    if (output_offset != target_size) {
+        throw std::runtime_error("bps: patch ended before target was complete");
+    }
+    if (source_crc.get() != read_le32(patch + footer)) {
+        throw std::runtime_error("bps: source checksum mismatch");
+    }
+    if (target_crc != read_le32(patch + footer + 4)) {
+        throw std::runtime_error("bps: target checksum mismatch");
+    }
+    return target;
+}
+
+}
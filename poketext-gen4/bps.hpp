@@ -0,0 +1,33 @@
+//
+//  bps.hpp
+//  poketext-gen4
+//
+
+#ifndef bps_hpp
+#define bps_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bps {
+
+// Builds a BPS patch turning `source` into `target`.
+// Bytes that stayed at the same offset become SourceRead runs; data that
+// moved (a bank that grew and was relocated, or everything behind it) is
+// found through content-defined anchors sampled across the whole source,
+// and short literal runs are rechecked with a suffix array over the source
+// around them.
+std::vector<uint8_t> create(const uint8_t* source, size_t source_size,
+                            const uint8_t* target, size_t target_size,
+                            const std::string& metadata = "");
+
+// Applies a BPS patch. Throws std::runtime_error on malformed patches and
+// on source, target or patch CRC mismatches.
+std::vector<uint8_t> apply(const uint8_t* source, size_t source_size,
+                           const uint8_t* patch, size_t patch_size);
+
+}
+
+#endif /* bps_hpp */
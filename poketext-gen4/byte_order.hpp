@@ -0,0 +1,54 @@
+//
+//  byte_order.hpp
+//  poketext-gen4
+//
+
+#ifndef byte_order_hpp
+#define byte_order_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Little-endian integers, as stored by the NDS, zip and BPS formats and by
+// our own index files. The fixed-width reads are single loads on
+// little-endian hosts, so the hashing and inflate loops use them too.
+
+inline uint16_t read_le16(const uint8_t* p) {
+    return uint16_t(p[0] | p[1] << 8);
+}
+
+inline uint32_t read_le32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+inline uint64_t read_le64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+inline uint64_t read_le(const uint8_t* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) {
+        v |= uint64_t(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+// The low `bytes` bytes of `v`, appended.
+inline void put_le(std::vector<uint8_t>& out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+}
+
+#endif /* byte_order_hpp */
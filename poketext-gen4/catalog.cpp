@@ -0,0 +1,197 @@
+//
+//  catalog.cpp
+//  poketext-gen4
+//
+
+#include "catalog.hpp"
+
+#include "file_io.hpp"
+#include "parallel.hpp"
+#include "rom_image.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr const char* kIndexHeader = "poketext-catalog\t1";
+
+std::string escape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+        case '\\': out += "\\\\"; break;
+        case '\t': out += "\\t"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        default: out.push_back(c);
+        }
+    }
+    return out;
+}
+
+std::string unescape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] != '\\' || i + 1 == s.size()) {
+            out.push_back(s[i]);
+            continue;
+        }
+        switch (s[++i]) {
+        case 't': out.push_back('\t'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        default: out.push_back(s[i]);
+        }
+    }
+    return out;
+}
+
+std::vector<std::string> split_tabs(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab - start));
+        if (tab == std::string::npos) break;
+        start = tab + 1;
+    }
+    return fields;
+}
+
+void read_rom(const std::string& path, Catalog::Entry& e) {
+    e.is_rom = false;
+    try {
+        RomImage rom(path);
+        auto header = parse_nds_header(rom.prefix(NdsHeader::kSize), std::min(rom.size(), NdsHeader::kSize));
+        if (!header) return;
+        e.is_rom = true;
+        e.game_code = header->game_code;
+        e.maker_code = header->maker_code;
+        e.header_title = header->title;
+        e.revision = header->revision;
+        const size_t banner = header->banner_offset;
+        if (banner == 0 || banner >= rom.size()) return;
+        const size_t banner_size = std::min(NdsBanner::kMaxSize, rom.size() - banner);
+        if (auto b = parse_nds_banner(rom.prefix(banner + banner_size) + banner, banner_size)) {
+            e.titles = b->titles;
+        }
+    } catch (const std::exception&) {
+        // Unreadable files stay in the index as non-ROMs so they are not
+        // retried until they change.
+    }
+}
+
+} // namespace
+
+Catalog Catalog::load(const std::string& index_path) {
+    Catalog catalog;
+    std::ifstream in(index_path);
+    std::string line;
+    if (!in || !std::getline(in, line) || line != kIndexHeader) {
+        return catalog;
+    }
+    constexpr size_t kFields = 8 + NdsBanner::kLanguages;
+    while (std::getline(in, line)) {
+        std::vector<std::string> f = split_tabs(line);
+        if (f.size() != kFields) continue;
+        Entry e;
+        try {
+            e.size = std::stoull(f[1]);
+            e.mtime = std::stoll(f[2]);
+            e.revision = static_cast<uint8_t>(std::stoul(f[5]));
+        } catch (const std::exception&) {
+            continue; // a damaged line only costs a re-read of that file
+        }
+        e.path = unescape(f[0]);
+        e.is_rom = f[3] == "1";
+        e.game_code = unescape(f[4]);
+        e.maker_code = unescape(f[6]);
+        e.header_title = unescape(f[7]);
+        for (size_t i = 0; i < NdsBanner::kLanguages; i++) {
+            e.titles[i] = unescape(f[8 + i]);
+        }
+        catalog.entries_.push_back(std::move(e));
+    }
+    std::sort(catalog.entries_.begin(), catalog.entries_.end(),
+              [](const Entry& a, const Entry& b) { return a.path < b.path; });
+    return catalog;
+}
+
+void Catalog::save(const std::string& index_path) const {
+    std::ostringstream out;
+    out << kIndexHeader << '\n';
+    for (const Entry& e : entries_) {
+        out << escape(e.path) << '\t' << e.size << '\t' << e.mtime << '\t' << (e.is_rom ? 1 : 0)
+            << '\t' << escape(e.game_code) << '\t' << int(e.revision) << '\t' << escape(e.maker_code)
+            << '\t' << escape(e.header_title);
+        for (const std::string& title : e.titles) {
+            out << '\t' << escape(title);
+        }
+        out << '\n';
+    }
+    // Write then rename, so an interrupted save never leaves half an index.
+    const std::string tmp = index_path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::trunc);
+        file << out.str();
+        if (!file) {
+            throw std::runtime_error("cannot write " + tmp);
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, index_path, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        throw std::runtime_error("cannot write " + index_path);
+    }
+}
+
+Catalog::ScanStats Catalog::scan(const std::string& root) {
+    std::vector<Entry> found;
+    for (auto it = fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied);
+         it != fs::recursive_directory_iterator(); ++it) {
+        // Only the directory listing here; stats happen in parallel below.
+        std::error_code ec;
+        const std::string name = it->path().filename().string();
+        if (it->is_regular_file(ec) && (has_extension(name, ".nds") || has_extension(name, ".zip"))) {
+            Entry e;
+            e.path = it->path().lexically_relative(root).generic_string();
+            found.push_back(std::move(e));
+        }
+    }
+    std::sort(found.begin(), found.end(), [](const Entry& a, const Entry& b) { return a.path < b.path; });
+    
+    std::unordered_map<std::string, const Entry*> previous;
+    for (const Entry& e : entries_) {
+        previous.emplace(e.path, &e);
+    }
+    
+    std::vector<uint8_t> reread(found.size());
+    parallel_for(found.size(), [&](size_t i) {
+        Entry& e = found[i];
+        const fs::path full = fs::path(root) / e.path;
+        std::error_code ec;
+        e.size = fs::file_size(full, ec);
+        auto mtime = fs::last_write_time(full, ec);
+        e.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+        auto it = previous.find(e.path);
+        if (it != previous.end() && it->second->size == e.size && it->second->mtime == e.mtime) {
+            e = *it->second;
+            return;
+        }
+        read_rom(full.string(), e);
+        reread[i] = 1;
+    });
+    
+    entries_ = std::move(found);
+    return {entries_.size(), static_cast<size_t>(std::count(reread.begin(), reread.end(), 1))};
+}
@@ -0,0 +1,55 @@
+//
+//  catalog.hpp
+//  poketext-gen4
+//
+
+#ifndef catalog_hpp
+#define catalog_hpp
+
+#include "nds_header.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Index of the ROMs under a directory, built from their headers and
+// banners only. It is saved next to the library and reused on the next
+// scan for every file whose size and modification time are unchanged,
+// so a re-scan only stats the files it already knows.
+class Catalog {
+public:
+    struct Entry {
+        std::string path; // relative to the scanned root
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        bool is_rom = false; // false for unreadable files and non-ROM zips
+        std::string game_code;
+        std::string maker_code;
+        std::string header_title;
+        uint8_t revision = 0;
+        std::array<std::string, NdsBanner::kLanguages> titles;
+    };
+    
+    struct ScanStats {
+        size_t files = 0;
+        size_t reread = 0;
+    };
+    
+    // Loads a saved index; a missing or outdated file gives an empty catalog.
+    static Catalog load(const std::string& index_path);
+    // Throws std::runtime_error if the index cannot be written.
+    void save(const std::string& index_path) const;
+    
+    // Rescans the .nds and .zip files under `root`, in parallel. Entries for
+    // files that are gone are dropped.
+    ScanStats scan(const std::string& root);
+    
+    const std::vector<Entry>& entries() const { return entries_; }
+    
+private:
+    std::vector<Entry> entries_; // sorted by path
+};
+
+#endif /* catalog_hpp */
@@ -0,0 +1,26 @@
+//
+//  checksum.hpp
+//  poketext-gen4
+//
+
+#ifndef checksum_hpp
+#define checksum_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 (zlib/PKZIP polynomial), as used by BPS and zip.
+// Pass the previous return value as `crc` to continue a running checksum.
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+// CRC-32C (Castagnoli), using the SSE4.2 or ARMv8 CRC instructions when
+// the CPU has them.
+uint32_t crc32c(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+// CRC-16/MODBUS, as used for the NDS header and banner checksums.
+uint16_t crc16(const uint8_t* data, size_t size, uint16_t crc = 0xFFFF);
+
+// XXH64, a fast non-cryptographic hash used for ROM fingerprints.
+uint64_t xxh64(const uint8_t* data, size_t size, uint64_t seed = 0);
+
+#endif /* checksum_hpp */
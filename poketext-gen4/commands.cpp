@@ -0,0 +1,365 @@
+//
+//  commands.cpp
+//  poketext-gen4
+//
+
+#include "commands.hpp"
+
+#include "bps.hpp"
+#include "catalog.hpp"
+#include "file_io.hpp"
+#include "fingerprint.hpp"
+#include "minhash.hpp"
+#include "nds_header.hpp"
+#include "rom_image.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+int bps_create(Session& session, const Args& args, std::ostream& out) {
+    std::shared_ptr<RomImage> source = session.rom(args[0]);
+    std::shared_ptr<RomImage> target = session.rom(args[1]);
+    std::vector<uint8_t> patch = bps::create(source->data(), source->size(), target->data(), target->size());
+    write_file(args[2], patch.data(), patch.size());
+    out << args[2] << ": " << patch.size() << " bytes\n";
+    return 0;
+}
+
+int bps_apply(Session& session, const Args& args, std::ostream& out) {
+    std::shared_ptr<RomImage> source = session.rom(args[0]);
+    MappedFile patch(args[1]);
+    std::vector<uint8_t> target = bps::apply(source->data(), source->size(), patch.data(), patch.size());
+    write_file(args[2], target.data(), target.size());
+    out << args[2] << ": " << target.size() << " bytes\n";
+    return 0;
+}
+
+std::ostream& hex(std::ostream& out, uint64_t value, int width) {
+    return out << std::hex << std::setfill('0') << std::setw(width) << value
+               << std::dec << std::setfill(' ');
+}
+
+int fingerprint(Session& session, const Args& args, std::ostream& out) {
+    std::vector<std::string> inputs;
+    std::string save_path;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "-o" && i + 1 < args.size()) {
+            save_path = args[++i];
+        } else {
+            inputs.push_back(args[i]);
+        }
+    }
+    if (inputs.empty() || inputs.size() > 2) {
+        throw std::runtime_error("fingerprint takes one or two inputs");
+    }
+    
+    const Fingerprint& base = *session.fingerprint(inputs[0]);
+    if (!save_path.empty()) {
+        std::vector<uint8_t> bytes = base.save();
+        write_file(save_path, bytes.data(), bytes.size());
+    }
+    hex(out << inputs[0] << ": ", base.root(), 16)
+        << " size " << base.size() << " chunks " << base.chunks().size() << '\n';
+    if (inputs.size() == 1) {
+        return 0;
+    }
+    
+    const Fingerprint& other = *session.fingerprint(inputs[1]);
+    hex(out << inputs[1] << ": ", other.root(), 16)
+        << " size " << other.size() << " chunks " << other.chunks().size() << '\n';
+    if (base.root() == other.root()) {
+        out << "identical\n";
+        return 0;
+    }
+    for (const auto& [begin, end] : base.changed_ranges(other)) {
+        hex(hex(out << "changed ", begin, 8) << "-", end, 8) << " (" << (end - begin) << " bytes)\n";
+    }
+    // changed_ranges() only covers bytes the second image has; a tail cut
+    // off at a chunk boundary leaves no differing chunk to report.
+    if (other.size() < base.size()) {
+        hex(hex(out << "removed ", other.size(), 8) << "-", base.size(), 8)
+            << " (" << (base.size() - other.size()) << " bytes)\n";
+    }
+    return 2;
+}
+
+// Files named directly, plus every .nds or .zip file under the directories named.
+std::vector<std::string> collect_roms(const std::vector<std::string>& paths) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> roms;
+    for (const std::string& path : paths) {
+        if (!fs::is_directory(path)) {
+            roms.push_back(path);
+            continue;
+        }
+        for (const auto& entry : fs::recursive_directory_iterator(path, fs::directory_options::skip_permission_denied)) {
+            const std::string name = entry.path().filename().string();
+            if (entry.is_regular_file() && (has_extension(name, ".nds") || has_extension(name, ".zip"))) {
+                roms.push_back(entry.path().string());
+            }
+        }
+    }
+    std::sort(roms.begin(), roms.end());
+    roms.erase(std::unique(roms.begin(), roms.end()), roms.end());
+    return roms;
+}
+
+// Whether `path` is `root` or lies below it, compared by path component.
+bool is_under(const std::string& path, const std::string& root) {
+    namespace fs = std::filesystem;
+    fs::path r = fs::path(root).lexically_normal();
+    const fs::path p = fs::path(path).lexically_normal();
+    if (r == ".") {
+        return p.is_relative() && *p.begin() != "..";
+    }
+    if (r.filename().empty()) {
+        r = r.parent_path(); // trailing separator
+    }
+    return std::mismatch(r.begin(), r.end(), p.begin(), p.end()).first == r.end();
+}
+
+int similar_index(Session& session, const Args& args, std::ostream& out) {
+    namespace fs = std::filesystem;
+    const Args roots(args.begin() + 1, args.end());
+    minhash::Index previous;
+    if (fs::exists(args[0])) {
+        MappedFile file(args[0]);
+        previous = minhash::Index::load(file.data(), file.size());
+    }
+    // Entries outside the roots scanned are kept as they are. Those under
+    // them are kept while their file's size and mtime match, signed again
+    // when they do not, and dropped when the file is gone.
+    minhash::Index index;
+    std::unordered_map<std::string, const minhash::Entry*> unseen;
+    for (const minhash::Entry& e : previous.entries()) {
+        if (std::any_of(roots.begin(), roots.end(), [&](const std::string& r) { return is_under(e.path, r); })) {
+            unseen[fs::path(e.path).lexically_normal().string()] = &e;
+        } else {
+            index.add(e);
+        }
+    }
+    size_t added = 0, updated = 0, skipped = 0;
+    for (const std::string& path : collect_roms(roots)) {
+        const minhash::Entry* old = nullptr;
+        if (auto it = unseen.find(fs::path(path).lexically_normal().string()); it != unseen.end()) {
+            old = it->second;
+            unseen.erase(it);
+            std::error_code size_error, time_error;
+            const uintmax_t size = fs::file_size(path, size_error);
+            const auto mtime = fs::last_write_time(path, time_error);
+            if (!size_error && !time_error && old->size == size &&
+                old->mtime == static_cast<int64_t>(mtime.time_since_epoch().count())) {
+                index.add(*old);
+                continue;
+            }
+        }
+        std::shared_ptr<const minhash::Entry> entry;
+        try {
+            entry = session.rom_signature(path);
+        } catch (const std::exception& e) {
+            // One broken file (or a zip with no ROM in it) should not cost
+            // the rest of the scan.
+            std::cerr << "poketext-gen4: warning: " << e.what() << ", skipped\n";
+            skipped++;
+            continue;
+        }
+        if (!entry->is_rom) {
+            skipped++;
+            continue;
+        }
+        index.add(*entry);
+        (old ? updated : added)++;
+    }
+    std::vector<uint8_t> bytes = index.save();
+    write_file(args[0], bytes.data(), bytes.size());
+    out << args[0] << ": " << added << " added, " << updated << " updated, " << unseen.size() << " removed, "
+        << skipped << " skipped, " << index.size() << " total\n";
+    return 0;
+}
+
+int similar(Session& session, const Args& args, std::ostream& out) {
+    std::shared_ptr<const minhash::Index> index = session.similarity_index(args[0]);
+    const minhash::Entry& rom = *session.rom_signature(args[1]);
+    out << rom.path << ": " << rom.game_code << " rev " << int(rom.revision) << '\n';
+    auto matches = index->query(rom.signature, 5);
+    if (matches.empty()) {
+        out << "  no similar ROM in index\n";
+        return 2;
+    }
+    for (const minhash::Match& m : matches) {
+        out << "  " << std::fixed << std::setprecision(1) << std::setw(5) << m.similarity * 100 << "% "
+            << m.entry->game_code << " rev " << int(m.entry->revision) << "  " << m.entry->path << '\n';
+    }
+    return 0;
+}
+
+// English title if the banner has one, on one line.
+std::string display_title(const Catalog::Entry& e) {
+    std::string title = !e.titles[1].empty() ? e.titles[1] : !e.titles[0].empty() ? e.titles[0] : e.header_title;
+    std::string out;
+    for (char c : title) {
+        if (c == '\n') {
+            out += " / ";
+        } else {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+// `text` padded with spaces to `width` code points; setw() counts bytes,
+// which would shift everything after an accented title.
+std::string pad(const std::string& text, size_t width) {
+    size_t length = 0;
+    for (char c : text) {
+        length += (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+    }
+    return length < width ? text + std::string(width - length, ' ') : text;
+}
+
+int catalog(Session&, const Args& args, std::ostream& out) {
+    std::string index_path = (std::filesystem::path(args[0]) / ".poketext-catalog").string();
+    for (size_t i = 1; i + 1 < args.size(); i++) {
+        if (args[i] == "-o") index_path = args[++i];
+    }
+    Catalog catalog = Catalog::load(index_path);
+    const Catalog::ScanStats stats = catalog.scan(args[0]);
+    try {
+        catalog.save(index_path);
+    } catch (const std::exception& e) {
+        // A read-only library can still be listed; it is just rescanned in full next time.
+        std::cerr << "poketext-gen4: warning: " << e.what() << ", catalog not saved\n";
+    }
+    
+    size_t roms = 0;
+    for (const Catalog::Entry& e : catalog.entries()) {
+        if (!e.is_rom) continue;
+        roms++;
+        out << std::left << std::setw(6) << e.game_code << "rev " << std::setw(3) << int(e.revision)
+            << std::setw(10) << nds_region(e.game_code) << pad(display_title(e), 40)
+            << std::right << e.path << '\n';
+    }
+    out << roms << " ROMs in " << stats.files << " files, " << stats.reread << " read\n";
+    return 0;
+}
+
+int pipe(Session& session, const Args&, std::ostream& out) {
+    std::ios::sync_with_stdio(false);
+    return run_pipe(session, std::cin, out);
+}
+
+const Command kCommands[] = {
+    {"bps-create", "<original.nds> <edited.nds> <out.bps>", 3, false, bps_create},
+    {"bps-apply", "<original.nds> <patch.bps> <out.nds>", 3, false, bps_apply},
+    {"fingerprint", "<rom|.fp> [<rom|.fp>] [-o out.fp]", 1, false, fingerprint},
+    {"similar-index", "<index> <rom|dir>...", 2, false, similar_index},
+    {"similar", "<index> <rom>", 2, false, similar},
+    {"catalog", "<dir> [-o index]", 1, false, catalog},
+    {"pipe", "(commands on stdin, one per line)", 0, true, pipe},
+};
+
+} // namespace
+
+const Command* find_command(const std::string& name) {
+    for (const Command& c : kCommands) {
+        if (name == c.name) return &c;
+    }
+    return nullptr;
+}
+
+Args split_command(const std::string& line) {
+    Args words;
+    std::string word;
+    bool in_word = false, quoted = false;
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '\\' && i + 1 < line.size()) {
+                word.push_back(line[++i]);
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                word.push_back(c);
+            }
+        } else if (c == '"') {
+            quoted = in_word = true;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            if (in_word) words.push_back(std::move(word));
+            word.clear();
+            in_word = false;
+        } else {
+            word.push_back(c);
+            in_word = true;
+        }
+    }
+    if (quoted) {
+        throw std::runtime_error("unterminated quote");
+    }
+    if (in_word) words.push_back(std::move(word));
+    return words;
+}
+
+int run_pipe(Session& session, std::istream& in, std::ostream& out) {
+    constexpr size_t kFlushThreshold = 64 * 1024;
+    std::string pending;
+    auto flush = [&] {
+        out.write(pending.data(), static_cast<std::streamsize>(pending.size()));
+        out.flush();
+        pending.clear();
+    };
+    
+    int failures = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        // Comments are skipped before tokenising, so their text can be anything.
+        const size_t first = line.find_first_not_of(" \t\n\v\f\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        std::ostringstream result;
+        int status;
+        try {
+            Args words = split_command(line);
+            if (words.empty()) continue;
+            if (words[0] == "flush") {
+                flush();
+                continue;
+            }
+            const Command* c = find_command(words[0]);
+            if (!c || c->keeps_session) {
+                throw std::runtime_error("unknown command '" + words[0] + "'");
+            }
+            Args args(words.begin() + 1, words.end());
+            if (args.size() < c->min_args) {
+                throw std::runtime_error(std::string("usage: ") + c->name + " " + c->usage);
+            }
+            status = c->run(session, args, result);
+        } catch (const std::exception& e) {
+            result << "error: " << e.what() << '\n';
+            status = 1;
+        }
+        failures += status == 1;
+        result << "end " << status << '\n';
+        pending += result.str();
+        if (pending.size() >= kFlushThreshold || in.rdbuf()->in_avail() <= 0) {
+            flush();
+        }
+    }
+    flush();
+    return failures ? 1 : 0;
+}
+
+void print_usage(std::ostream& out) {
+    out << "usage:" << std::endl;
+    for (const Command& c : kCommands) {
+        out << "  poketext-gen4 [--perf-counters] " << c.name << " " << c.usage << std::endl;
+    }
+}
+
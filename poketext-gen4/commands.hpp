@@ -0,0 +1,45 @@
+//
+//  commands.hpp
+//  poketext-gen4
+//
+
+#ifndef commands_hpp
+#define commands_hpp
+
+#include "session.hpp"
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using Args = std::vector<std::string>;
+
+struct Command {
+    const char* name;
+    const char* usage;
+    size_t min_args;
+    // Runs other commands against its session, which should keep ROMs.
+    bool keeps_session;
+    // Returns the exit status; failures throw std::runtime_error.
+    int (*run)(Session& session, const Args& args, std::ostream& out);
+};
+
+const Command* find_command(const std::string& name);
+void print_usage(std::ostream& out);
+
+// Splits a command line on whitespace; double quotes group words and
+// backslash escapes the next character inside them.
+Args split_command(const std::string& line);
+
+// Runs newline-delimited commands from `in` against one session, so ROMs,
+// fingerprints and indexes stay loaded between them. Each command's output
+// is followed by "end <status>", preceded by "error: ..." if it failed.
+// Output is buffered and written when the buffer fills or when `in` has
+// nothing more queued, so a caller waiting on each answer never stalls.
+// Blank lines and lines starting with '#' are skipped. Returns 1 if any
+// command failed.
+int run_pipe(Session& session, std::istream& in, std::ostream& out);
+
+#endif /* commands_hpp */
@@ -0,0 +1,43 @@
+//
+//  file_io.hpp
+//  poketext-gen4
+//
+
+#ifndef file_io_hpp
+#define file_io_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only memory mapping of a whole file. ROMs are up to 128 MB and
+// most of it is never touched, so mapping beats reading it in.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    
+private:
+    void release();
+    
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+void write_file(const std::string& path, const uint8_t* data, size_t size);
+
+// Whether `name` ends in `ext` (e.g. ".nds"), ignoring case. Works on zip
+// member names as well as paths.
+bool has_extension(const std::string& name, const char* ext);
+
+#endif /* file_io_hpp */
@@ -0,0 +1,163 @@
+//
+//  fingerprint.cpp
+//  poketext-gen4
+//
+
+#include "fingerprint.hpp"
+
+#include "byte_order.hpp"
+#include "checksum.hpp"
+#include "parallel.hpp"
+#include "perf_counters.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint8_t kMagic[4] = {'P', 'T', 'F', 'P'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 4 + 4 + 8 + 4 + 4;
+constexpr size_t kChunkRecordSize = 8 + 4;
+
+// Interior nodes hash their children's values; a lone child at the right
+// edge is hashed on its own so a node's value also pins its width.
+uint64_t hash_node(const uint64_t* children, size_t count) {
+    uint8_t buf[16];
+    for (size_t i = 0; i < count; i++) {
+        std::memcpy(buf + 8 * i, &children[i], 8);
+    }
+    return xxh64(buf, 8 * count, count);
+}
+
+} // namespace
+
+Fingerprint::Fingerprint(const uint8_t* data, size_t size, uint32_t chunk_size)
+    : size_(size), chunk_size_(chunk_size) {
+    if (chunk_size == 0) {
+        throw std::invalid_argument("fingerprint chunk size must be positive");
+    }
+    perf::Stage stage("hash", size);
+    chunks_.resize((size + chunk_size - 1) / chunk_size);
+    parallel_for(chunks_.size(), [&](size_t i) {
+        const uint8_t* p = data + i * chunk_size;
+        size_t n = std::min<size_t>(chunk_size, size - i * chunk_size);
+        chunks_[i] = {xxh64(p, n), crc32c(p, n)};
+    });
+    build_tree();
+}
+
+void Fingerprint::build_tree() {
+    levels_.clear();
+    std::vector<uint64_t> leaves(chunks_.size());
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        uint64_t leaf[2] = {chunks_[i].hash, chunks_[i].crc};
+        leaves[i] = hash_node(leaf, 2);
+    }
+    if (leaves.empty()) {
+        leaves.push_back(0);
+    }
+    levels_.push_back(std::move(leaves));
+    while (levels_.back().size() > 1) {
+        const std::vector<uint64_t>& below = levels_.back();
+        std::vector<uint64_t> above((below.size() + 1) / 2);
+        for (size_t i = 0; i < above.size(); i++) {
+            above[i] = hash_node(&below[2 * i], std::min<size_t>(2, below.size() - 2 * i));
+        }
+        levels_.push_back(std::move(above));
+    }
+    // Mix in the exact size so images that differ only in where the last
+    // chunk ends can never share a root.
+    uint64_t top[2] = {levels_.back().front(), size_};
+    root_ = hash_node(top, 2);
+}
+
+bool Fingerprint::is_fingerprint_file(const uint8_t* data, size_t size) {
+    return size >= kHeaderSize && std::memcmp(data, kMagic, 4) == 0;
+}
+
+Fingerprint Fingerprint::load(const uint8_t* data, size_t size) {
+    if (!is_fingerprint_file(data, size) || read_le32(data + 4) != kVersion) {
+        throw std::runtime_error("not a fingerprint file");
+    }
+    Fingerprint fp;
+    fp.size_ = read_le64(data + 8);
+    fp.chunk_size_ = static_cast<uint32_t>(read_le32(data + 16));
+    const size_t count = static_cast<size_t>(read_le32(data + 20));
+    if (fp.chunk_size_ == 0 || size != kHeaderSize + count * kChunkRecordSize
+        || count != (fp.size_ + fp.chunk_size_ - 1) / fp.chunk_size_) {
+        throw std::runtime_error("corrupt fingerprint file");
+    }
+    fp.chunks_.resize(count);
+    const uint8_t* p = data + kHeaderSize;
+    for (Chunk& c : fp.chunks_) {
+        c.hash = read_le64(p);
+        c.crc = static_cast<uint32_t>(read_le32(p + 8));
+        p += kChunkRecordSize;
+    }
+    fp.build_tree();
+    return fp;
+}
+
+std::vector<uint8_t> Fingerprint::save() const {
+    std::vector<uint8_t> out(kMagic, kMagic + 4);
+    out.reserve(kHeaderSize + chunks_.size() * kChunkRecordSize);
+    put_le(out, kVersion, 4);
+    put_le(out, size_, 8);
+    put_le(out, chunk_size_, 4);
+    put_le(out, chunks_.size(), 4);
+    for (const Chunk& c : chunks_) {
+        put_le(out, c.hash, 8);
+        put_le(out, c.crc, 4);
+    }
+    return out;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> Fingerprint::changed_ranges(const Fingerprint& other) const {
+    std::vector<std::pair<uint64_t, uint64_t>> out;
+    if (chunk_size_ != other.chunk_size_) {
+        // Trees over different chunkings cannot be compared node by node.
+        if (other.size_ > 0) out.push_back({0, other.size_});
+        return out;
+    }
+    if (root() == other.root()) {
+        return out;
+    }
+    const size_t top = std::max(levels_.size(), other.levels_.size()) - 1;
+    diff(other, top, 0, out);
+    return out;
+}
+
+void Fingerprint::diff(const Fingerprint& other, size_t level, size_t index,
+                       std::vector<std::pair<uint64_t, uint64_t>>& out) const {
+    auto node = [level, index](const Fingerprint& fp, uint64_t& value) {
+        if (level >= fp.levels_.size() || index >= fp.levels_[level].size()) return false;
+        value = fp.levels_[level][index];
+        return true;
+    };
+    uint64_t mine = 0, theirs = 0;
+    const bool have_mine = node(*this, mine);
+    const bool have_theirs = node(other, theirs);
+    if (!have_theirs && level < other.levels_.size()) {
+        return; // past the end of `other`: nothing of it lives here
+    }
+    if (have_mine && have_theirs && mine == theirs) {
+        return;
+    }
+    if (level > 0) {
+        diff(other, level - 1, 2 * index, out);
+        diff(other, level - 1, 2 * index + 1, out);
+        return;
+    }
+    if (index >= other.chunks_.size()) {
+        return;
+    }
+    const uint64_t begin = uint64_t(index) * chunk_size_;
+    const uint64_t end = std::min<uint64_t>(begin + chunk_size_, other.size_);
+    if (!out.empty() && out.back().second == begin) {
+        out.back().second = end;
+    } else {
+        out.push_back({begin, end});
+    }
+}
@@ -0,0 +1,60 @@
+//
+//  fingerprint.hpp
+//  poketext-gen4
+//
+
+#ifndef fingerprint_hpp
+#define fingerprint_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ROM identity for cache keys: the image is cut into fixed-size chunks,
+// each hashed with XXH64 and CRC-32C in parallel, and the chunk digests
+// are combined into a Merkle tree. The root identifies the ROM; comparing
+// two trees top-down finds the chunks that differ without touching the
+// ones that match.
+class Fingerprint {
+public:
+    static constexpr uint32_t kDefaultChunkSize = 1024 * 1024;
+    
+    struct Chunk {
+        uint64_t hash;
+        uint32_t crc;
+    };
+    
+    Fingerprint() = default;
+    Fingerprint(const uint8_t* data, size_t size, uint32_t chunk_size = kDefaultChunkSize);
+    
+    // Reads a tree written by save(). Throws std::runtime_error if the
+    // bytes are not a fingerprint file.
+    static Fingerprint load(const uint8_t* data, size_t size);
+    static bool is_fingerprint_file(const uint8_t* data, size_t size);
+    std::vector<uint8_t> save() const;
+    
+    uint64_t root() const { return root_; }
+    uint64_t size() const { return size_; }
+    const std::vector<Chunk>& chunks() const { return chunks_; }
+    
+    // Byte ranges [begin, end) of `other` whose chunks differ from this one,
+    // adjacent chunks merged. Bytes this image has past the end of `other`
+    // are not covered, so compare root() to tell whether the two match.
+    std::vector<std::pair<uint64_t, uint64_t>> changed_ranges(const Fingerprint& other) const;
+    
+private:
+    void build_tree();
+    void diff(const Fingerprint& other, size_t level, size_t index,
+              std::vector<std::pair<uint64_t, uint64_t>>& out) const;
+    
+    uint64_t root_ = 0;
+    uint64_t size_ = 0;
+    uint32_t chunk_size_ = kDefaultChunkSize;
+    std::vector<Chunk> chunks_;
+    // levels_[0] holds the leaf nodes, levels_.back() the root.
+    std::vector<std::vector<uint64_t>> levels_;
+};
+
+#endif /* fingerprint_hpp */
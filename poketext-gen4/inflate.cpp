@@ -0,0 +1,361 @@
+//
+//  inflate.cpp
+//  poketext-gen4
+//
+
+#include "inflate.hpp"
+
+#include "byte_order.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Table entry layout: bits 0-4 bits consumed (0 = not in the fast table),
+// bits 5-6 symbol count, bits 7-15 first symbol, bits 16-23 second literal.
+constexpr uint32_t entry(uint32_t length, uint32_t nsym, uint32_t sym1, uint32_t sym2 = 0) {
+    return length | nsym << 5 | sym1 << 7 | sym2 << 16;
+}
+constexpr uint32_t entry_length(uint32_t e) { return e & 0x1F; }
+constexpr uint32_t entry_count(uint32_t e) { return (e >> 5) & 3; }
+constexpr uint32_t entry_sym1(uint32_t e) { return (e >> 7) & 0x1FF; }
+constexpr uint32_t entry_sym2(uint32_t e) { return (e >> 16) & 0xFF; }
+
+constexpr uint16_t kLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+constexpr uint8_t kLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+constexpr uint16_t kDistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+constexpr uint8_t kDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+constexpr uint8_t kCodeLengthOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15,
+};
+
+[[noreturn]] void corrupt(const char* what) {
+    throw std::runtime_error(std::string("inflate: ") + what);
+}
+
+uint32_t reverse_bits(uint32_t code, int length) {
+    uint32_t r = 0;
+    for (int i = 0; i < length; i++) {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+} // namespace
+
+// Lookup table for one Huffman code. Codes up to kFastBits long decode
+// with a single lookup; a literal/length entry may hold two literals when
+// both codes fit in those bits. Longer codes fall back to canonical
+// decoding bit by bit.
+struct Inflater::Table {
+    static constexpr int kFastBits = 11;
+    
+    uint32_t fast[1 << kFastBits];
+    uint16_t count[16];
+    uint16_t symbols[288];
+    
+    void build(const uint8_t* lengths, int n, bool pair_literals);
+};
+
+void Inflater::Table::build(const uint8_t* lengths, int n, bool pair_literals) {
+    std::memset(count, 0, sizeof(count));
+    for (int s = 0; s < n; s++) {
+        count[lengths[s]]++;
+    }
+    count[0] = 0;
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left = (left << 1) - count[len];
+        if (left < 0) corrupt("over-subscribed code");
+    }
+    
+    uint16_t offsets[16] = {};
+    uint32_t next_code[16] = {};
+    uint32_t code = 0;
+    for (int len = 1; len < 16; len++) {
+        offsets[len] = static_cast<uint16_t>(offsets[len - 1] + count[len - 1]);
+        code = (code + count[len - 1]) << 1;
+        next_code[len] = code;
+    }
+    
+    std::memset(fast, 0, sizeof(fast));
+    for (int s = 0; s < n; s++) {
+        const int len = lengths[s];
+        if (len == 0) continue;
+        symbols[offsets[len]++] = static_cast<uint16_t>(s);
+        if (len > kFastBits) {
+            next_code[len]++;
+            continue;
+        }
+        const uint32_t e = entry(len, 1, s);
+        for (uint32_t i = reverse_bits(next_code[len]++, len); i < (1u << kFastBits); i += 1u << len) {
+            fast[i] = e;
+        }
+    }
+    
+    if (!pair_literals) return;
+    // Descending, so fast[i >> len] (never above i) is still a single entry.
+    for (uint32_t i = (1u << kFastBits); i-- > 0;) {
+        const uint32_t first = fast[i];
+        const uint32_t len1 = entry_length(first);
+        if (len1 == 0 || len1 >= kFastBits || entry_sym1(first) >= 256) continue;
+        const uint32_t second = fast[i >> len1];
+        const uint32_t len2 = entry_length(second);
+        if (len2 == 0 || entry_count(second) != 1 || len1 + len2 > kFastBits || entry_sym1(second) >= 256) continue;
+        fast[i] = entry(len1 + len2, 2, entry_sym1(first), entry_sym1(second));
+    }
+}
+
+Inflater::Inflater(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_capacity)
+    : in_(in), in_end_(in + in_size), out_(out), out_capacity_(out_capacity),
+      lit_(std::make_unique<Table>()), dist_(std::make_unique<Table>()) {}
+
+Inflater::~Inflater() = default;
+
+inline void Inflater::refill() {
+    if (in_end_ - in_ >= 8) {
+        // Branch-free refill: bits past bitcount_ are always the next input
+        // bytes, so overlapping loads agree with what is already there.
+        bitbuf_ |= read_le64(in_) << bitcount_;
+        in_ += (63 - bitcount_) >> 3;
+        bitcount_ |= 56;
+    } else {
+        while (bitcount_ <= 56 && in_ < in_end_) {
+            bitbuf_ |= uint64_t(*in_++) << bitcount_;
+            bitcount_ += 8;
+        }
+    }
+}
+
+inline uint32_t Inflater::bits(int n) {
+    if (n > bitcount_) corrupt("truncated stream");
+    uint32_t v = static_cast<uint32_t>(bitbuf_ & ((uint64_t(1) << n) - 1));
+    bitbuf_ >>= n;
+    bitcount_ -= n;
+    return v;
+}
+
+inline int Inflater::decode(const Table& t) {
+    const uint32_t e = t.fast[bitbuf_ & ((1u << Table::kFastBits) - 1)];
+    const int len = static_cast<int>(entry_length(e));
+    if (len != 0) {
+        if (len > bitcount_) corrupt("truncated stream");
+        bitbuf_ >>= len;
+        bitcount_ -= len;
+        return static_cast<int>(entry_sym1(e));
+    }
+    // Canonical decode one bit at a time, for codes longer than the table.
+    int code = 0, first = 0, index = 0;
+    for (int l = 1; l < 16; l++) {
+        code |= static_cast<int>(bits(1));
+        const int count = t.count[l];
+        if (code - count < first) {
+            return t.symbols[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    corrupt("invalid Huffman code");
+}
+
+size_t Inflater::inflate_until(size_t want) {
+    want = std::min(want, out_capacity_);
+    while (out_pos_ < want && mode_ != Mode::Done) {
+        switch (mode_) {
+        case Mode::Header:
+            if (final_block_) {
+                mode_ = Mode::Done;
+                break;
+            }
+            read_block_header();
+            break;
+        case Mode::Stored:
+            inflate_stored(want);
+            break;
+        case Mode::Huffman:
+            inflate_huffman(want);
+            break;
+        case Mode::Done:
+            break;
+        }
+    }
+    // A final block that ends exactly at `want` still finishes the stream.
+    if (mode_ == Mode::Header && final_block_) {
+        mode_ = Mode::Done;
+    }
+    return out_pos_;
+}
+
+void Inflater::read_block_header() {
+    refill();
+    final_block_ = bits(1) != 0;
+    switch (bits(2)) {
+    case 0: {
+        // Drop to a byte boundary and hand the whole bytes back to the input.
+        bits(bitcount_ & 7);
+        in_ -= bitcount_ >> 3;
+        bitbuf_ = 0;
+        bitcount_ = 0;
+        if (in_end_ - in_ < 4) corrupt("truncated stream");
+        const uint16_t len = uint16_t(in_[0] | in_[1] << 8);
+        const uint16_t nlen = uint16_t(in_[2] | in_[3] << 8);
+        if (len != uint16_t(~nlen)) corrupt("stored block length mismatch");
+        in_ += 4;
+        stored_remaining_ = len;
+        mode_ = Mode::Stored;
+        break;
+    }
+    case 1: {
+        uint8_t lengths[288 + 32];
+        std::fill(lengths, lengths + 144, 8);
+        std::fill(lengths + 144, lengths + 256, 9);
+        std::fill(lengths + 256, lengths + 280, 7);
+        std::fill(lengths + 280, lengths + 288, 8);
+        std::fill(lengths + 288, lengths + 320, 5);
+        lit_->build(lengths, 288, true);
+        dist_->build(lengths + 288, 32, false);
+        mode_ = Mode::Huffman;
+        break;
+    }
+    case 2:
+        read_dynamic_tables();
+        mode_ = Mode::Huffman;
+        break;
+    default:
+        corrupt("invalid block type");
+    }
+}
+
+void Inflater::read_dynamic_tables() {
+    refill();
+    const int nlit = static_cast<int>(bits(5)) + 257;
+    const int ndist = static_cast<int>(bits(5)) + 1;
+    const int ncode = static_cast<int>(bits(4)) + 4;
+    if (nlit > 286 || ndist > 30) corrupt("too many length or distance codes");
+    
+    uint8_t code_lengths[19] = {};
+    for (int i = 0; i < ncode; i++) {
+        refill();
+        code_lengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(bits(3));
+    }
+    Table& cl = *dist_; // free until the distance code is built
+    cl.build(code_lengths, 19, false);
+    
+    uint8_t lengths[286 + 30] = {};
+    int n = 0;
+    while (n < nlit + ndist) {
+        refill();
+        const int sym = decode(cl);
+        if (sym < 16) {
+            lengths[n++] = static_cast<uint8_t>(sym);
+            continue;
+        }
+        uint8_t value = 0;
+        int repeat;
+        if (sym == 16) {
+            if (n == 0) corrupt("repeat with no previous length");
+            value = lengths[n - 1];
+            repeat = 3 + static_cast<int>(bits(2));
+        } else if (sym == 17) {
+            repeat = 3 + static_cast<int>(bits(3));
+        } else {
+            repeat = 11 + static_cast<int>(bits(7));
+        }
+        if (n + repeat > nlit + ndist) corrupt("too many code lengths");
+        std::fill(lengths + n, lengths + n + repeat, value);
+        n += repeat;
+    }
+    if (lengths[256] == 0) corrupt("missing end-of-block code");
+    lit_->build(lengths, nlit, true);
+    dist_->build(lengths + nlit, ndist, false);
+}
+
+void Inflater::inflate_stored(size_t want) {
+    const size_t n = std::min(stored_remaining_, want - out_pos_);
+    if (static_cast<size_t>(in_end_ - in_) < n) corrupt("truncated stream");
+    std::memcpy(out_ + out_pos_, in_, n);
+    in_ += n;
+    out_pos_ += n;
+    stored_remaining_ -= n;
+    if (stored_remaining_ == 0) {
+        mode_ = Mode::Header;
+    }
+}
+
+void Inflater::inflate_huffman(size_t want) {
+    const uint32_t mask = (1u << Table::kFastBits) - 1;
+    const Table& lit = *lit_;
+    const Table& dist = *dist_;
+    size_t pos = out_pos_;
+    uint8_t* const out = out_;
+    const size_t capacity = out_capacity_;
+    
+    while (pos < want) {
+        // 56 bits cover the longest symbol: 15 + 5 extra + 15 + 13 extra.
+        refill();
+        const uint32_t e = lit.fast[bitbuf_ & mask];
+        int sym;
+        if (entry_count(e) == 2) {
+            const int len = static_cast<int>(entry_length(e));
+            if (len > bitcount_) corrupt("truncated stream");
+            if (capacity - pos < 2) corrupt("output larger than expected");
+            bitbuf_ >>= len;
+            bitcount_ -= len;
+            out[pos++] = static_cast<uint8_t>(entry_sym1(e));
+            out[pos++] = static_cast<uint8_t>(entry_sym2(e));
+            continue;
+        }
+        sym = decode(lit);
+        if (sym < 256) {
+            if (pos == capacity) corrupt("output larger than expected");
+            out[pos++] = static_cast<uint8_t>(sym);
+            continue;
+        }
+        if (sym == 256) {
+            mode_ = Mode::Header;
+            break;
+        }
+        sym -= 257;
+        if (sym >= 29) corrupt("invalid length symbol");
+        const size_t length = kLengthBase[sym] + bits(kLengthExtra[sym]);
+        const int dsym = decode(dist);
+        if (dsym >= 30) corrupt("invalid distance symbol");
+        const size_t dist = kDistBase[dsym] + bits(kDistExtra[dsym]);
+        if (dist > pos) corrupt("distance too far back");
+        if (length > capacity - pos) corrupt("output larger than expected");
+        
+        uint8_t* dst = out + pos;
+        const uint8_t* src = dst - dist;
+        if (dist >= 8 && capacity - pos >= length + 8) {
+            // Whole words; may write up to 7 bytes past the match, which the
+            // next symbol overwrites.
+            for (size_t i = 0; i < length; i += 8) {
+                uint64_t w;
+                std::memcpy(&w, src + i, 8);
+                std::memcpy(dst + i, &w, 8);
+            }
+        } else {
+            for (size_t i = 0; i < length; i++) {
+                dst[i] = src[i];
+            }
+        }
+        pos += length;
+    }
+    out_pos_ = pos;
+}
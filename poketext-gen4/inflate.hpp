@@ -0,0 +1,56 @@
+//
+//  inflate.hpp
+//  poketext-gen4
+//
+
+#ifndef inflate_hpp
+#define inflate_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Raw DEFLATE (RFC 1951) decoder over an in-memory input, writing into a
+// caller-owned buffer. Decoding can stop once enough output exists and
+// pick up where it left off, so a zipped ROM is only inflated as far as
+// anything has read into it.
+class Inflater {
+public:
+    Inflater(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_capacity);
+    
+    // Decodes until at least `want` bytes of output exist (clamped to the
+    // capacity) or the stream ends, and returns the bytes produced so far.
+    // Throws std::runtime_error on corrupt or truncated input.
+    size_t inflate_until(size_t want);
+    
+    ~Inflater();
+    
+private:
+    enum class Mode { Header, Stored, Huffman, Done };
+    struct Table;
+    
+    void refill();
+    uint32_t bits(int n);
+    int decode(const Table& t);
+    void read_block_header();
+    void read_dynamic_tables();
+    void inflate_stored(size_t want);
+    void inflate_huffman(size_t want);
+    
+    const uint8_t* in_;
+    const uint8_t* in_end_;
+    uint8_t* out_;
+    size_t out_capacity_;
+    size_t out_pos_ = 0;
+    
+    uint64_t bitbuf_ = 0;
+    int bitcount_ = 0;
+    
+    Mode mode_ = Mode::Header;
+    bool final_block_ = false;
+    size_t stored_remaining_ = 0;
+    std::unique_ptr<Table> lit_;
+    std::unique_ptr<Table> dist_;
+};
+
+#endif /* inflate_hpp */
@@ -5,11 +5,48 @@
 //  Created by Giovanni Maria Tomaselli on 19/01/24.
 //
 
+#include "commands.hpp"
+#include "perf_counters.hpp"
+#include "session.hpp"
+
+#include <cstring>
+#include <exception>
 #include <iostream>
 
-int main() {
+int main(int argc, const char * argv[]) {
+    
+    int first = 1;
+    if (first < argc && std::strcmp(argv[first], "--perf-counters") == 0) {
+        perf::enable();
+        first++;
+    }
+    if (first >= argc) {
+        print_usage(std::cerr);
+        return 1;
+    }
     
-    std::cout << "Hello, World!" << std::endl;
+    const Command* c = find_command(argv[first]);
+    if (!c) {
+        std::cerr << "poketext-gen4: unknown command '" << argv[first] << "'" << std::endl;
+        print_usage(std::cerr);
+        return 1;
+    }
+    Args args(argv + first + 1, argv + argc);
+    if (args.size() < c->min_args) {
+        std::cerr << "usage: poketext-gen4 " << c->name << " " << c->usage << std::endl;
+        return 1;
+    }
     
-    return 0;
+    Session session(c->keeps_session ? Session::kPipeRoms : 0);
+    int status;
+    try {
+        status = c->run(session, args, std::cout);
+    } catch (const std::exception& e) {
+        std::cout.flush();
+        std::cerr << "poketext-gen4: " << e.what() << std::endl;
+        status = 1;
+    }
+    std::cout.flush();
+    perf::report(std::cerr);
+    return status;
 }
@@ -0,0 +1,183 @@
+//
+//  minhash.cpp
+//  poketext-gen4
+//
+
+#include "minhash.hpp"
+
+#include "byte_order.hpp"
+#include "checksum.hpp"
+#include "parallel.hpp"
+#include "perf_counters.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace minhash {
+
+namespace {
+
+constexpr size_t kShingle = 8;
+constexpr size_t kSliceSize = 1024 * 1024;
+constexpr uint8_t kMagic[4] = {'P', 'T', 'M', 'H'};
+constexpr uint32_t kVersion = 3;
+
+// Shingle hash: the 8 bytes as one word, through a 64-bit finalizer.
+inline uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+inline void fold(Signature& sig, uint64_t h) {
+    size_t bucket = h >> 56;
+    uint32_t value = static_cast<uint32_t>(h);
+    if (value < sig[bucket]) sig[bucket] = value;
+}
+
+} // namespace
+
+static_assert(kBuckets == 256, "bucket index is the top byte of the shingle hash");
+
+Signature signature(const uint8_t* data, size_t size) {
+    perf::Stage stage("minhash", size);
+    Signature sig;
+    sig.fill(kEmpty);
+    if (size < kShingle) {
+        return sig;
+    }
+    const size_t shingles = size - kShingle + 1;
+    const size_t slices = (shingles + kSliceSize - 1) / kSliceSize;
+    std::vector<Signature> partial(slices);
+    parallel_for(slices, [&](size_t s) {
+        Signature& local = partial[s];
+        local.fill(kEmpty);
+        const size_t begin = s * kSliceSize;
+        const size_t end = std::min(shingles, begin + kSliceSize);
+        for (size_t i = begin; i < end; i++) {
+            uint64_t word;
+            std::memcpy(&word, data + i, kShingle);
+            fold(local, mix(word));
+        }
+    });
+    for (const Signature& local : partial) {
+        for (size_t b = 0; b < kBuckets; b++) {
+            sig[b] = std::min(sig[b], local[b]);
+        }
+    }
+    return sig;
+}
+
+double similarity(const Signature& a, const Signature& b) {
+    size_t used = 0, equal = 0;
+    for (size_t i = 0; i < kBuckets; i++) {
+        if (a[i] == kEmpty && b[i] == kEmpty) continue;
+        used++;
+        equal += a[i] == b[i];
+    }
+    return used ? double(equal) / double(used) : 0.0;
+}
+
+uint64_t Index::band_key(const Signature& sig, size_t band) {
+    return xxh64(reinterpret_cast<const uint8_t*>(&sig[band * kRowsPerBand]),
+                 kRowsPerBand * sizeof(uint32_t), band);
+}
+
+void Index::add(Entry entry) {
+    const uint32_t id = static_cast<uint32_t>(entries_.size());
+    for (size_t band = 0; band < kBands; band++) {
+        buckets_[band_key(entry.signature, band)].push_back(id);
+    }
+    entries_.push_back(std::move(entry));
+}
+
+std::vector<Match> Index::query(const Signature& sig, size_t limit) const {
+    std::vector<uint32_t> candidates;
+    for (size_t band = 0; band < kBands; band++) {
+        auto it = buckets_.find(band_key(sig, band));
+        if (it != buckets_.end()) {
+            candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    
+    std::vector<Match> matches;
+    matches.reserve(candidates.size());
+    for (uint32_t id : candidates) {
+        matches.push_back({&entries_[id], similarity(sig, entries_[id].signature)});
+    }
+    std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+        return a.similarity > b.similarity;
+    });
+    if (matches.size() > limit) {
+        matches.resize(limit);
+    }
+    return matches;
+}
+
+std::vector<uint8_t> Index::save() const {
+    std::vector<uint8_t> out(kMagic, kMagic + 4);
+    put_le(out, kVersion, 4);
+    put_le(out, entries_.size(), 4);
+    for (const Entry& e : entries_) {
+        put_le(out, e.path.size(), 4);
+        out.insert(out.end(), e.path.begin(), e.path.end());
+        std::string code = e.game_code;
+        code.resize(4, ' ');
+        out.insert(out.end(), code.begin(), code.end());
+        out.push_back(e.revision);
+        put_le(out, e.size, 8);
+        put_le(out, static_cast<uint64_t>(e.mtime), 8);
+        for (uint32_t v : e.signature) {
+            put_le(out, v, 4);
+        }
+    }
+    return out;
+}
+
+Index Index::load(const uint8_t* data, size_t size) {
+    size_t p = 0;
+    auto need = [&](size_t n) {
+        if (size - p < n) throw std::runtime_error("corrupt similarity index");
+    };
+    auto get = [&](int bytes) {
+        need(bytes);
+        uint64_t v = read_le(data + p, bytes);
+        p += bytes;
+        return v;
+    };
+    if (size < 12 || std::memcmp(data, kMagic, 4) != 0) {
+        throw std::runtime_error("not a similarity index");
+    }
+    p = 4;
+    if (get(4) != kVersion) {
+        throw std::runtime_error("unsupported similarity index version");
+    }
+    Index index;
+    const size_t count = static_cast<size_t>(get(4));
+    for (size_t i = 0; i < count; i++) {
+        Entry e;
+        e.is_rom = true;
+        size_t len = static_cast<size_t>(get(4));
+        need(len + 4);
+        e.path.assign(reinterpret_cast<const char*>(data + p), len);
+        p += len;
+        e.game_code.assign(reinterpret_cast<const char*>(data + p), 4);
+        p += 4;
+        e.revision = static_cast<uint8_t>(get(1));
+        e.size = get(8);
+        e.mtime = static_cast<int64_t>(get(8));
+        for (uint32_t& v : e.signature) {
+            v = static_cast<uint32_t>(get(4));
+        }
+        index.add(std::move(e));
+    }
+    return index;
+}
+
+}
@@ -0,0 +1,77 @@
+//
+//  minhash.hpp
+//  poketext-gen4
+//
+
+#ifndef minhash_hpp
+#define minhash_hpp
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One-permutation MinHash over the 8-byte shingles of a ROM image.
+// Every shingle is hashed once; the top bits pick a bucket and each bucket
+// keeps its minimum, so the signature estimates Jaccard similarity between
+// shingle sets at a single pass over the data.
+namespace minhash {
+
+constexpr size_t kBuckets = 256;
+constexpr uint32_t kEmpty = 0xFFFFFFFF;
+
+using Signature = std::array<uint32_t, kBuckets>;
+
+Signature signature(const uint8_t* data, size_t size);
+
+// Estimated fraction of shingles the two images share.
+double similarity(const Signature& a, const Signature& b);
+
+struct Entry {
+    std::string path;
+    // False when the file has no valid NDS header; game_code is "????"
+    // then. Only ROMs are stored in an Index.
+    bool is_rom = false;
+    std::string game_code;
+    uint8_t revision = 0;
+    // File size and modification time (file_time_type ticks) when signed,
+    // so a rescan can tell which entries are stale.
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    Signature signature;
+};
+
+struct Match {
+    const Entry* entry;
+    double similarity;
+};
+
+// Locality-sensitive hashing over signature bands, so a query only scores
+// the ROMs that share at least one whole band with it.
+class Index {
+public:
+    static constexpr size_t kRowsPerBand = 4;
+    static constexpr size_t kBands = kBuckets / kRowsPerBand;
+    
+    void add(Entry entry);
+    // Best matches first, at most `limit` of them.
+    std::vector<Match> query(const Signature& sig, size_t limit) const;
+    size_t size() const { return entries_.size(); }
+    const std::vector<Entry>& entries() const { return entries_; }
+    
+    std::vector<uint8_t> save() const;
+    // Throws std::runtime_error if the bytes are not an index file.
+    static Index load(const uint8_t* data, size_t size);
+    
+private:
+    static uint64_t band_key(const Signature& sig, size_t band);
+    
+    std::vector<Entry> entries_;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> buckets_;
+};
+
+}
+
+#endif /* minhash_hpp */
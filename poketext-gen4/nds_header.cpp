@@ -0,0 +1,118 @@
+//
+//  nds_header.cpp
+//  poketext-gen4
+//
+
+#include "nds_header.hpp"
+
+#include "byte_order.hpp"
+#include "checksum.hpp"
+
+namespace {
+
+std::string header_string(const uint8_t* p, size_t max) {
+    std::string s;
+    for (size_t i = 0; i < max && p[i] != 0; i++) {
+        s.push_back(static_cast<char>(p[i]));
+    }
+    return s;
+}
+
+void append_utf8(std::string& out, uint32_t c) {
+    if (c < 0x80) {
+        out.push_back(static_cast<char>(c));
+    } else if (c < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | c >> 6));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | c >> 12));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | c >> 18));
+        out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+}
+
+// A NUL-terminated UTF-16LE title of at most `units` code units.
+std::string banner_title(const uint8_t* p, size_t units) {
+    std::string s;
+    for (size_t i = 0; i < units; i++) {
+        uint32_t c = read_le16(p + 2 * i);
+        if (c == 0) break;
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < units) {
+            uint32_t low = read_le16(p + 2 * (i + 1));
+            if (low >= 0xDC00 && low < 0xE000) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+        append_utf8(s, c);
+    }
+    return s;
+}
+
+} // namespace
+
+std::string nds_region(const std::string& game_code) {
+    switch (game_code.size() == 4 ? game_code[3] : 0) {
+    case 'J': return "Japan";
+    case 'E': return "USA";
+    case 'P': return "Europe";
+    case 'D': return "Germany";
+    case 'F': return "France";
+    case 'I': return "Italy";
+    case 'S': return "Spain";
+    case 'K': return "Korea";
+    case 'U': return "Australia";
+    default: return "Unknown";
+    }
+}
+
+std::optional<NdsHeader> parse_nds_header(const uint8_t* data, size_t size) {
+    if (size < NdsHeader::kSize) {
+        return std::nullopt;
+    }
+    if (crc16(data, 0x15E) != read_le16(data + 0x15E)) {
+        return std::nullopt;
+    }
+    NdsHeader h;
+    h.title = header_string(data, 12);
+    h.game_code = header_string(data + 0x0C, 4);
+    h.maker_code = header_string(data + 0x10, 2);
+    h.revision = data[0x1E];
+    h.banner_offset = read_le32(data + 0x68);
+    return h;
+}
+
+std::optional<NdsBanner> parse_nds_banner(const uint8_t* data, size_t size) {
+    constexpr size_t kTitles = 0x240;
+    constexpr size_t kTitleSize = 0x100;
+    constexpr size_t kV1Size = 0x840;
+    if (size < kV1Size) {
+        return std::nullopt;
+    }
+    NdsBanner b;
+    b.version = read_le16(data);
+    size_t languages;
+    switch (b.version) {
+    case 1: languages = 6; break;
+    case 2: languages = 7; break;
+    case 3:
+    case 0x103: languages = 8; break;
+    default: return std::nullopt;
+    }
+    if (size < kTitles + languages * kTitleSize) {
+        return std::nullopt;
+    }
+    // The first checksum always covers the version 1 area.
+    if (crc16(data + 0x20, kV1Size - 0x20) != read_le16(data + 2)) {
+        return std::nullopt;
+    }
+    for (size_t i = 0; i < languages; i++) {
+        b.titles[i] = banner_title(data + kTitles + i * kTitleSize, kTitleSize / 2);
+    }
+    return b;
+}
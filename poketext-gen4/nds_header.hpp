@@ -0,0 +1,46 @@
+//
+//  nds_header.hpp
+//  poketext-gen4
+//
+
+#ifndef nds_header_hpp
+#define nds_header_hpp
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// The fields of the cartridge header at offset 0 that identify a ROM.
+struct NdsHeader {
+    static constexpr size_t kSize = 0x200;
+    
+    std::string title;      // e.g. "POKEMON D"
+    std::string game_code;  // e.g. "ADAE"
+    std::string maker_code; // "01" for Nintendo
+    uint8_t revision = 0;
+    uint32_t banner_offset = 0;
+};
+
+// Region named by a game code's last character, e.g. "ADAE" -> "USA".
+std::string nds_region(const std::string& game_code);
+
+// Parses the header if `data` starts with one whose checksum matches.
+std::optional<NdsHeader> parse_nds_header(const uint8_t* data, size_t size);
+
+// The icon/title banner the header points to. Version 1 has six titles;
+// version 2 adds Chinese and version 3 Korean.
+struct NdsBanner {
+    static constexpr size_t kLanguages = 8;
+    static constexpr size_t kMaxSize = 0xA40;
+    
+    uint16_t version = 0;
+    // UTF-8, lines separated by '\n'; empty where the banner has no title.
+    std::array<std::string, kLanguages> titles;
+};
+
+// Parses the banner at the start of `data` if its checksum matches.
+std::optional<NdsBanner> parse_nds_banner(const uint8_t* data, size_t size);
+
+#endif /* nds_header_hpp */
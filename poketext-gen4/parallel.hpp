@@ -0,0 +1,40 @@
+//
+//  parallel.hpp
+//  poketext-gen4
+//
+
+#ifndef parallel_hpp
+#define parallel_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Runs fn(0) ... fn(count - 1) across the hardware threads, handing out
+// indices one at a time. Threads are only started when there is more than
+// one item, and the calling thread does its share. fn must not throw.
+template <typename F>
+void parallel_for(size_t count, F&& fn) {
+    size_t workers = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; i++) fn(i);
+        return;
+    }
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) {
+            fn(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t w = 1; w < workers; w++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (std::thread& t : threads) t.join();
+}
+
+#endif /* parallel_hpp */
@@ -0,0 +1,221 @@
+//
+//  perf_counters.cpp
+//  poketext-gen4
+//
+
+#include "perf_counters.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perf {
+
+namespace {
+
+enum Counter { Cycles, Instructions, CacheMisses, BranchMisses };
+
+struct Totals {
+    const char* name;
+    // Stages open inside this many other stages, the first time it ran.
+    int depth = 0;
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    int64_t wall_ns = 0;
+    uint64_t counts[4] = {};
+    // Per counter: whether any call managed to read it.
+    bool counted[4] = {};
+};
+
+struct State {
+    bool enabled = false;
+    bool counters_available = false;
+    std::string unavailable_reason;
+    std::mutex mutex;
+    std::vector<Totals> stages; // in order of first use
+};
+
+State& state() {
+    static State s;
+    return s;
+}
+
+// Stages currently open on this thread.
+thread_local int open_stages = 0;
+
+// Caller holds the state mutex.
+Totals& totals(State& s, const char* name) {
+    for (Totals& existing : s.stages) {
+        if (std::strcmp(existing.name, name) == 0) return existing;
+    }
+    s.stages.push_back({name, open_stages});
+    return s.stages.back();
+}
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if defined(__linux__)
+constexpr uint64_t kConfigs[4] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int open_counter(uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // Other events can push ours off the PMU; these let counts be scaled
+    // back up to the full interval.
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+#endif
+
+void probe_counters(State& s) {
+#if defined(__linux__)
+    int fd = open_counter(PERF_COUNT_HW_INSTRUCTIONS);
+    if (fd < 0) {
+        s.unavailable_reason = std::string("perf_event_open: ") + std::strerror(errno);
+        return;
+    }
+    close(fd);
+    s.counters_available = true;
+#else
+    s.unavailable_reason = "perf_event is only available on Linux";
+#endif
+}
+
+} // namespace
+
+void enable() {
+    State& s = state();
+    if (s.enabled) return;
+    s.enabled = true;
+    probe_counters(s);
+}
+
+Stage::Stage(const char* name, uint64_t bytes) : name_(name), bytes_(bytes) {
+    State& s = state();
+    if (!s.enabled) return;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        totals(s, name_);
+    }
+    open_stages++;
+#if defined(__linux__)
+    if (s.counters_available) {
+        for (int i = 0; i < kCounters; i++) {
+            fds_[i] = open_counter(kConfigs[i]);
+        }
+        for (int fd : fds_) {
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+    start_ns_ = now_ns();
+}
+
+Stage::~Stage() {
+    State& s = state();
+    if (!s.enabled) return;
+    const int64_t elapsed = now_ns() - start_ns_;
+    open_stages--;
+    uint64_t counts[kCounters] = {};
+    bool counted[kCounters] = {};
+#if defined(__linux__)
+    for (int i = 0; i < kCounters; i++) {
+        if (fds_[i] < 0) continue;
+        ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+        // value, time enabled, time running
+        uint64_t values[3] = {};
+        if (read(fds_[i], values, sizeof(values)) == sizeof(values) && values[2] > 0) {
+            counts[i] = values[2] < values[1]
+                ? static_cast<uint64_t>(double(values[0]) * values[1] / values[2])
+                : values[0];
+            counted[i] = true;
+        }
+        close(fds_[i]);
+    }
+#endif
+    std::lock_guard<std::mutex> lock(s.mutex);
+    Totals& t = totals(s, name_);
+    t.calls++;
+    t.bytes += bytes_;
+    t.wall_ns += elapsed;
+    for (int i = 0; i < kCounters; i++) {
+        t.counts[i] += counts[i];
+        t.counted[i] |= counted[i];
+    }
+}
+
+void report(std::ostream& out) {
+    State& s = state();
+    if (!s.enabled) return;
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.counters_available) {
+        out << "hardware counters unavailable (" << s.unavailable_reason << "), wall time only" << std::endl;
+    }
+    out << std::left << std::setw(12) << "stage" << std::right
+        << std::setw(8) << "calls" << std::setw(12) << "ms" << std::setw(12) << "MB";
+    if (s.counters_available) {
+        out << std::setw(8) << "IPC" << std::setw(14) << "cache-miss/KB" << std::setw(15) << "branch-miss/KB";
+    }
+    out << std::endl;
+    for (const Totals& t : s.stages) {
+        const double kb = t.bytes / 1024.0;
+        out << std::left << std::setw(12) << (std::string(2 * t.depth, ' ') + t.name) << std::right << std::fixed
+            << std::setw(8) << t.calls
+            << std::setw(12) << std::setprecision(2) << t.wall_ns / 1e6
+            << std::setw(12) << std::setprecision(1) << t.bytes / (1024.0 * 1024.0);
+        if (s.counters_available) {
+            // A counter that could not be opened or read shows "-" rather
+            // than a rate computed from zero.
+            if (t.counted[Cycles] && t.counted[Instructions] && t.counts[Cycles] > 0) {
+                out << std::setw(8) << std::setprecision(2) << double(t.counts[Instructions]) / t.counts[Cycles];
+            } else {
+                out << std::setw(8) << "-";
+            }
+            if (t.counted[CacheMisses] && kb > 0) {
+                out << std::setw(14) << std::setprecision(3) << t.counts[CacheMisses] / kb;
+            } else {
+                out << std::setw(14) << "-";
+            }
+            if (t.counted[BranchMisses] && kb > 0) {
+                out << std::setw(15) << std::setprecision(3) << t.counts[BranchMisses] / kb;
+            } else {
+                out << std::setw(15) << "-";
+            }
+        }
+        out << std::endl;
+    }
+    for (const Totals& t : s.stages) {
+        if (t.depth > 0) {
+            out << "indented stages ran inside the stage above them and are included in its totals" << std::endl;
+            break;
+        }
+    }
+}
+
+}
@@ -0,0 +1,45 @@
+//
+//  perf_counters.hpp
+//  poketext-gen4
+//
+
+#ifndef perf_counters_hpp
+#define perf_counters_hpp
+
+#include <cstdint>
+#include <ostream>
+
+// Hardware counters (cycles, instructions, cache and branch misses) around
+// pipeline stages, enabled by --perf-counters. Stages are no-ops unless
+// enabled; when the kernel refuses perf_event_open (containers, macOS),
+// only wall time is collected and the report says why.
+namespace perf {
+
+void enable();
+
+// Measures from construction to destruction and adds the result to the
+// stage's totals. Threads started inside the scope are counted too, and so
+// are stages nested in it: totals are inclusive.
+class Stage {
+public:
+    // `bytes` is the input the stage processed, for per-KB rates.
+    explicit Stage(const char* name, uint64_t bytes = 0);
+    ~Stage();
+    
+    Stage(const Stage&) = delete;
+    Stage& operator=(const Stage&) = delete;
+    
+private:
+    static constexpr int kCounters = 4;
+    
+    const char* name_;
+    uint64_t bytes_;
+    int64_t start_ns_ = 0;
+    int fds_[kCounters] = {-1, -1, -1, -1};
+};
+
+void report(std::ostream& out);
+
+}
+
+#endif /* perf_counters_hpp */
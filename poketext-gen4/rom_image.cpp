@@ -0,0 +1,88 @@
+//
+//  rom_image.cpp
+//  poketext-gen4
+//
+
+#include "rom_image.hpp"
+
+#include "checksum.hpp"
+#include "perf_counters.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+RomImage::RomImage(const std::string& path) : path_(path) {
+    if (!has_extension(path, ".zip")) {
+        file_ = MappedFile(path);
+        data_ = file_.data();
+        size_ = available_ = file_.size();
+        return;
+    }
+    
+    zip_ = std::make_unique<ZipArchive>(path);
+    const ZipArchive::Member* rom = nullptr;
+    for (const ZipArchive::Member& m : zip_->members()) {
+        if (has_extension(m.name, ".nds")) {
+            rom = &m;
+            break;
+        }
+    }
+    if (!rom) {
+        throw std::runtime_error(path + ": no .nds file in archive");
+    }
+    path_ = path + ":" + rom->name;
+    size_ = rom->size;
+    expected_crc_ = rom->crc;
+    const uint8_t* compressed = zip_->compressed_data(*rom);
+    
+    switch (rom->method) {
+    case ZipArchive::kStored:
+        if (rom->compressed_size != rom->size) {
+            throw std::runtime_error(path_ + ": stored size mismatch");
+        }
+        // Mapped as is; available_ only tracks when the CRC is due.
+        data_ = compressed;
+        break;
+    case ZipArchive::kDeflated:
+        // Left uninitialised so untouched pages are never faulted in.
+        buffer_.reset(new uint8_t[std::max<size_t>(size_, 1)]);
+        data_ = buffer_.get();
+        inflater_ = std::make_unique<Inflater>(compressed, rom->compressed_size, buffer_.get(), size_);
+        break;
+    default:
+        throw std::runtime_error(path_ + ": unsupported compression method " + std::to_string(rom->method));
+    }
+}
+
+const uint8_t* RomImage::prefix(size_t n) {
+    if (!error_.empty()) {
+        throw std::runtime_error(error_);
+    }
+    n = std::min(n, size_);
+    if (n > available_) {
+        // A failed inflate leaves the stream part-way through, so the image
+        // stays failed rather than serving unchecked bytes to a later call.
+        try {
+            size_t produced = n;
+            if (inflater_) {
+                perf::Stage stage("inflate", n - available_);
+                produced = inflater_->inflate_until(n);
+            }
+            if (produced < n) {
+                throw std::runtime_error(path_ + ": compressed data ends early");
+            }
+            if (produced == size_ && crc32(data_, size_) != expected_crc_) {
+                throw std::runtime_error(path_ + ": CRC mismatch");
+            }
+            available_ = produced;
+        } catch (const std::exception& e) {
+            error_ = e.what();
+            inflater_.reset();
+            throw;
+        }
+        if (available_ == size_) {
+            inflater_.reset();
+        }
+    }
+    return data_;
+}
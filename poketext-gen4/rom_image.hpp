@@ -0,0 +1,48 @@
+//
+//  rom_image.hpp
+//  poketext-gen4
+//
+
+#ifndef rom_image_hpp
+#define rom_image_hpp
+
+#include "file_io.hpp"
+#include "inflate.hpp"
+#include "zip_reader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// A ROM opened from a .nds file or from the first .nds member of a .zip.
+// Plain and stored images are mapped. Deflated ones are inflated into
+// memory only as far as has been asked for, with no temporary files;
+// DEFLATE cannot seek, so reaching an offset inflates everything before it.
+class RomImage {
+public:
+    explicit RomImage(const std::string& path);
+    
+    size_t size() const { return size_; }
+    
+    // First `n` bytes (clamped to the size), inflating them if needed.
+    const uint8_t* prefix(size_t n);
+    // The whole image; a zip member's CRC is checked the first time all of
+    // it is asked for.
+    // Once inflating has failed, every later call throws the same error.
+    const uint8_t* data() { return prefix(size_); }
+    
+private:
+    std::string path_;
+    MappedFile file_;
+    std::unique_ptr<ZipArchive> zip_;
+    std::unique_ptr<uint8_t[]> buffer_;
+    std::unique_ptr<Inflater> inflater_;
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t available_ = 0;
+    uint32_t expected_crc_ = 0;
+    std::string error_;
+};
+
+#endif /* rom_image_hpp */
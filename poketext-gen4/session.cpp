@@ -0,0 +1,62 @@
+//
+//  session.cpp
+//  poketext-gen4
+//
+
+#include "session.hpp"
+
+#include "file_io.hpp"
+#include "nds_header.hpp"
+
+#include <algorithm>
+#include <filesystem>
+
+std::shared_ptr<RomImage> Session::rom(const std::string& path) {
+    return roms_.get(path, [](const std::string& p) {
+        return std::make_shared<RomImage>(p);
+    });
+}
+
+std::shared_ptr<RomImage> Session::rom_for_digest(const std::string& path) {
+    if (std::shared_ptr<RomImage> image = roms_.find(path)) {
+        return image;
+    }
+    return std::make_shared<RomImage>(path);
+}
+
+std::shared_ptr<const Fingerprint> Session::fingerprint(const std::string& path) {
+    return fingerprints_.get(path, [this](const std::string& p) {
+        std::shared_ptr<RomImage> image = rom_for_digest(p);
+        const uint8_t* head = image->prefix(4);
+        if (Fingerprint::is_fingerprint_file(head, image->size())) {
+            return std::make_shared<const Fingerprint>(Fingerprint::load(image->data(), image->size()));
+        }
+        return std::make_shared<const Fingerprint>(image->data(), image->size());
+    });
+}
+
+std::shared_ptr<const minhash::Entry> Session::rom_signature(const std::string& path) {
+    return signatures_.get(path, [this](const std::string& p) {
+        std::shared_ptr<RomImage> image = rom_for_digest(p);
+        auto entry = std::make_shared<minhash::Entry>();
+        entry->path = p;
+        entry->size = std::filesystem::file_size(p);
+        entry->mtime = static_cast<int64_t>(std::filesystem::last_write_time(p).time_since_epoch().count());
+        entry->game_code = "????";
+        const size_t header_size = std::min(image->size(), NdsHeader::kSize);
+        if (auto header = parse_nds_header(image->prefix(header_size), header_size)) {
+            entry->is_rom = true;
+            entry->game_code = header->game_code;
+            entry->revision = header->revision;
+        }
+        entry->signature = minhash::signature(image->data(), image->size());
+        return std::shared_ptr<const minhash::Entry>(std::move(entry));
+    });
+}
+
+std::shared_ptr<const minhash::Index> Session::similarity_index(const std::string& path) {
+    return indexes_.get(path, [](const std::string& p) {
+        MappedFile file(p);
+        return std::make_shared<const minhash::Index>(minhash::Index::load(file.data(), file.size()));
+    });
+}
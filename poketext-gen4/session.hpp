@@ -0,0 +1,116 @@
+//
+//  session.hpp
+//  poketext-gen4
+//
+
+#ifndef session_hpp
+#define session_hpp
+
+#include "fingerprint.hpp"
+#include "minhash.hpp"
+#include "rom_image.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Objects loaded from files, kept across the commands of one run so a
+// `pipe` session opens, inflates and hashes each ROM once. An entry is
+// reloaded when its file's size or modification time changes, and the
+// least recently used one is dropped past `capacity`; a capacity of 0
+// keeps nothing. Values are shared, so dropping one never invalidates what
+// a running command holds.
+template <typename T>
+class FileCache {
+public:
+    explicit FileCache(size_t capacity) : capacity_(capacity) {}
+    
+    template <typename Load>
+    std::shared_ptr<T> get(const std::string& path, Load load) {
+        if (capacity_ == 0) {
+            return load(path);
+        }
+        std::error_code size_error, time_error;
+        const uintmax_t size = std::filesystem::file_size(path, size_error);
+        const auto mtime = std::filesystem::last_write_time(path, time_error);
+        if (size_error || time_error) {
+            return load(path); // let the loader report the problem
+        }
+        auto it = slots_.find(path);
+        if (it != slots_.end() && it->second.size == size && it->second.mtime == mtime) {
+            it->second.last_use = ++clock_;
+            return it->second.value;
+        }
+        std::shared_ptr<T> value = load(path);
+        if (it == slots_.end() && slots_.size() >= capacity_) {
+            evict();
+        }
+        slots_[path] = {value, size, mtime, ++clock_};
+        return value;
+    }
+    
+    // The cached value if it is still current, without loading anything.
+    std::shared_ptr<T> find(const std::string& path) {
+        auto it = slots_.find(path);
+        if (it == slots_.end()) return nullptr;
+        std::error_code size_error, time_error;
+        const uintmax_t size = std::filesystem::file_size(path, size_error);
+        const auto mtime = std::filesystem::last_write_time(path, time_error);
+        if (size_error || time_error || it->second.size != size || it->second.mtime != mtime) {
+            return nullptr;
+        }
+        it->second.last_use = ++clock_;
+        return it->second.value;
+    }
+    
+private:
+    struct Slot {
+        std::shared_ptr<T> value;
+        uintmax_t size;
+        std::filesystem::file_time_type mtime;
+        uint64_t last_use;
+    };
+    
+    void evict() {
+        auto oldest = slots_.begin();
+        for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+            if (it->second.last_use < oldest->second.last_use) oldest = it;
+        }
+        if (oldest != slots_.end()) slots_.erase(oldest);
+    }
+    
+    size_t capacity_;
+    uint64_t clock_ = 0;
+    std::unordered_map<std::string, Slot> slots_;
+};
+
+class Session {
+public:
+    // Inflated zips are as large as the ROM, so a long-running session
+    // keeps only a few, and a single command keeps none past its own use.
+    static constexpr size_t kPipeRoms = 8;
+    
+    explicit Session(size_t rom_capacity) : roms_(rom_capacity) {}
+    
+    std::shared_ptr<RomImage> rom(const std::string& path);
+    // A ROM's fingerprint, or a tree saved by `fingerprint -o`. The image
+    // is read through rom() only if it is already cached; otherwise it is
+    // released once hashed, since the small result is what gets reused.
+    std::shared_ptr<const Fingerprint> fingerprint(const std::string& path);
+    // Header identity and MinHash signature of a ROM, read like fingerprint().
+    std::shared_ptr<const minhash::Entry> rom_signature(const std::string& path);
+    std::shared_ptr<const minhash::Index> similarity_index(const std::string& path);
+    
+private:
+    std::shared_ptr<RomImage> rom_for_digest(const std::string& path);
+    
+    FileCache<RomImage> roms_;
+    FileCache<const Fingerprint> fingerprints_{1024};
+    FileCache<const minhash::Entry> signatures_{1024};
+    FileCache<const minhash::Index> indexes_{4};
+};
+
+#endif /* session_hpp */
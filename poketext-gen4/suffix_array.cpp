@@ -0,0 +1,123 @@
+//
+//  suffix_array.cpp
+//  poketext-gen4
+//
+
+#include "suffix_array.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// SA-IS (Nong, Zhang & Chan). `s` holds symbols in [0, upper].
+std::vector<int32_t> sa_is(const std::vector<int32_t>& s, int32_t upper) {
+    const int32_t n = static_cast<int32_t>(s.size());
+    if (n == 0) return {};
+    if (n == 1) return {0};
+    if (n == 2) {
+        if (s[0] < s[1]) return {0, 1};
+        return {1, 0};
+    }
+    
+    std::vector<int32_t> sa(n);
+    std::vector<uint8_t> ls(n);
+    for (int32_t i = n - 2; i >= 0; i--) {
+        ls[i] = (s[i] == s[i + 1]) ? ls[i + 1] : (s[i] < s[i + 1]);
+    }
+    
+    std::vector<int32_t> sum_l(upper + 1), sum_s(upper + 1);
+    for (int32_t i = 0; i < n; i++) {
+        if (!ls[i]) {
+            sum_s[s[i]]++;
+        } else {
+            sum_l[s[i] + 1]++;
+        }
+    }
+    for (int32_t i = 0; i <= upper; i++) {
+        sum_s[i] += sum_l[i];
+        if (i < upper) sum_l[i + 1] += sum_s[i];
+    }
+    
+    std::vector<int32_t> buf(upper + 1);
+    auto induce = [&](const std::vector<int32_t>& lms) {
+        std::fill(sa.begin(), sa.end(), -1);
+        std::copy(sum_s.begin(), sum_s.end(), buf.begin());
+        for (int32_t d : lms) {
+            if (d == n) continue;
+            sa[buf[s[d]]++] = d;
+        }
+        std::copy(sum_l.begin(), sum_l.end(), buf.begin());
+        sa[buf[s[n - 1]]++] = n - 1;
+        for (int32_t i = 0; i < n; i++) {
+            int32_t v = sa[i];
+            if (v >= 1 && !ls[v - 1]) {
+                sa[buf[s[v - 1]]++] = v - 1;
+            }
+        }
+        std::copy(sum_l.begin(), sum_l.end(), buf.begin());
+        for (int32_t i = n - 1; i >= 0; i--) {
+            int32_t v = sa[i];
+            if (v >= 1 && ls[v - 1]) {
+                sa[--buf[s[v - 1] + 1]] = v - 1;
+            }
+        }
+    };
+    
+    std::vector<int32_t> lms_map(n + 1, -1);
+    std::vector<int32_t> lms;
+    for (int32_t i = 1; i < n; i++) {
+        if (!ls[i - 1] && ls[i]) {
+            lms_map[i] = static_cast<int32_t>(lms.size());
+            lms.push_back(i);
+        }
+    }
+    const int32_t m = static_cast<int32_t>(lms.size());
+    
+    induce(lms);
+    
+    if (m) {
+        std::vector<int32_t> sorted_lms;
+        sorted_lms.reserve(m);
+        for (int32_t v : sa) {
+            if (lms_map[v] != -1) sorted_lms.push_back(v);
+        }
+        std::vector<int32_t> rec_s(m);
+        int32_t rec_upper = 0;
+        rec_s[lms_map[sorted_lms[0]]] = 0;
+        for (int32_t i = 1; i < m; i++) {
+            int32_t l = sorted_lms[i - 1], r = sorted_lms[i];
+            int32_t end_l = (lms_map[l] + 1 < m) ? lms[lms_map[l] + 1] : n;
+            int32_t end_r = (lms_map[r] + 1 < m) ? lms[lms_map[r] + 1] : n;
+            bool same = true;
+            if (end_l - l != end_r - r) {
+                same = false;
+            } else {
+                while (l < end_l && s[l] == s[r]) {
+                    l++;
+                    r++;
+                }
+                if (l == n || s[l] != s[r]) same = false;
+            }
+            if (!same) rec_upper++;
+            rec_s[lms_map[sorted_lms[i]]] = rec_upper;
+        }
+        std::vector<int32_t> rec_sa = sa_is(rec_s, rec_upper);
+        for (int32_t i = 0; i < m; i++) {
+            sorted_lms[i] = lms[rec_sa[i]];
+        }
+        induce(sorted_lms);
+    }
+    return sa;
+}
+
+} // namespace
+
+std::vector<int32_t> build_suffix_array(const uint8_t* text, size_t size) {
+    if (size > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        throw std::length_error("suffix array input too large");
+    }
+    std::vector<int32_t> s(text, text + size);
+    return sa_is(s, 255);
+}
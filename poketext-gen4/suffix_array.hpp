@@ -0,0 +1,16 @@
+//
+//  suffix_array.hpp
+//  poketext-gen4
+//
+
+#ifndef suffix_array_hpp
+#define suffix_array_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Suffix array of a byte string, built with SA-IS in linear time.
+std::vector<int32_t> build_suffix_array(const uint8_t* text, size_t size);
+
+#endif /* suffix_array_hpp */
@@ -0,0 +1,98 @@
+//
+//  zip_reader.cpp
+//  poketext-gen4
+//
+
+#include "zip_reader.hpp"
+
+#include "byte_order.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t kEndOfCentralDirectory = 0x06054B50;
+constexpr uint32_t kCentralDirectoryEntry = 0x02014B50;
+constexpr uint32_t kLocalHeader = 0x04034B50;
+constexpr size_t kEndRecordSize = 22;
+constexpr size_t kMaxCommentSize = 0xFFFF;
+
+} // namespace
+
+ZipArchive::ZipArchive(const std::string& path) : path_(path), file_(path) {
+    const uint8_t* data = file_.data();
+    const size_t size = file_.size();
+    auto corrupt = [&](const char* what) {
+        return std::runtime_error(path_ + ": " + what);
+    };
+    if (size < kEndRecordSize) {
+        throw corrupt("not a zip archive");
+    }
+    
+    // The end record sits before an optional comment of up to 64 KB.
+    const size_t lowest = size - std::min(size, kEndRecordSize + kMaxCommentSize);
+    size_t end = size - kEndRecordSize + 1;
+    do {
+        end--;
+    } while (end > lowest && read_le32(data + end) != kEndOfCentralDirectory);
+    if (read_le32(data + end) != kEndOfCentralDirectory) {
+        throw corrupt("not a zip archive");
+    }
+    
+    const uint16_t count = read_le16(data + end + 10);
+    const uint32_t directory_size = read_le32(data + end + 12);
+    const uint32_t directory_offset = read_le32(data + end + 16);
+    if (count == 0xFFFF || directory_offset == 0xFFFFFFFF) {
+        throw corrupt("zip64 archives are not supported");
+    }
+    if (uint64_t(directory_offset) + directory_size > end) {
+        throw corrupt("central directory out of range");
+    }
+    
+    size_t p = directory_offset;
+    const size_t directory_end = p + directory_size;
+    members_.reserve(count);
+    for (uint16_t i = 0; i < count; i++) {
+        if (directory_end - p < 46 || read_le32(data + p) != kCentralDirectoryEntry) {
+            throw corrupt("corrupt central directory");
+        }
+        Member m;
+        m.flags = read_le16(data + p + 8);
+        m.method = read_le16(data + p + 10);
+        m.crc = read_le32(data + p + 16);
+        m.compressed_size = read_le32(data + p + 20);
+        m.size = read_le32(data + p + 24);
+        const size_t name_size = read_le16(data + p + 28);
+        const size_t extra_size = read_le16(data + p + 30);
+        const size_t comment_size = read_le16(data + p + 32);
+        m.local_header_offset = read_le32(data + p + 42);
+        if (m.compressed_size == 0xFFFFFFFF || m.size == 0xFFFFFFFF || m.local_header_offset == 0xFFFFFFFF) {
+            throw corrupt("zip64 archives are not supported");
+        }
+        const size_t record = 46 + name_size + extra_size + comment_size;
+        if (directory_end - p < record) {
+            throw corrupt("corrupt central directory");
+        }
+        m.name.assign(reinterpret_cast<const char*>(data + p + 46), name_size);
+        members_.push_back(std::move(m));
+        p += record;
+    }
+}
+
+const uint8_t* ZipArchive::compressed_data(const Member& member) const {
+    const uint8_t* data = file_.data();
+    const size_t size = file_.size();
+    const uint64_t at = member.local_header_offset;
+    if (member.flags & 1) {
+        throw std::runtime_error(path_ + ": " + member.name + " is encrypted");
+    }
+    if (at + 30 > size || read_le32(data + at) != kLocalHeader) {
+        throw std::runtime_error(path_ + ": bad local header for " + member.name);
+    }
+    const uint64_t start = at + 30 + read_le16(data + at + 26) + read_le16(data + at + 28);
+    if (start + member.compressed_size > size) {
+        throw std::runtime_error(path_ + ": " + member.name + " is truncated");
+    }
+    return data + start;
+}
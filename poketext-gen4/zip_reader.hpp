@@ -0,0 +1,46 @@
+//
+//  zip_reader.hpp
+//  poketext-gen4
+//
+
+#ifndef zip_reader_hpp
+#define zip_reader_hpp
+
+#include "file_io.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Central-directory view of a .zip archive, mapped rather than read.
+// Members may be stored or deflated; zip64 and encrypted archives are
+// rejected.
+class ZipArchive {
+public:
+    struct Member {
+        std::string name;
+        uint16_t method = 0;
+        uint16_t flags = 0;
+        uint32_t crc = 0;
+        uint64_t compressed_size = 0;
+        uint64_t size = 0;
+        uint64_t local_header_offset = 0;
+    };
+    
+    static constexpr uint16_t kStored = 0;
+    static constexpr uint16_t kDeflated = 8;
+    
+    explicit ZipArchive(const std::string& path);
+    
+    const std::vector<Member>& members() const { return members_; }
+    // The member's compressed bytes, located through its local header.
+    const uint8_t* compressed_data(const Member& member) const;
+    
+private:
+    std::string path_;
+    MappedFile file_;
+    std::vector<Member> members_;
+};
+
+#endif /* zip_reader_hpp */
@@ -0,0 +1,34 @@
+//
+//  check.hpp
+//  poketext-gen4 tests
+//
+
+#ifndef check_hpp
+#define check_hpp
+
+#include <iostream>
+
+// Minimal assertion support: CHECK records a failure and carries on, and
+// main returns check_result() so ctest sees any failure.
+inline int& check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            check_failures()++; \
+        } \
+    } while (0)
+
+inline int check_result() {
+    if (check_failures() != 0) {
+        std::cerr << check_failures() << " check(s) failed\n";
+        return 1;
+    }
+    return 0;
+}
+
+#endif /* check_hpp */
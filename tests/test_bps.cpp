@@ -0,0 +1,178 @@
+//
+//  test_bps.cpp
+//  poketext-gen4 tests
+//
+
+#include "check.hpp"
+
+#include "bps.hpp"
+#include "byte_order.hpp"
+#include "checksum.hpp"
+#include "suffix_array.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+std::mt19937 rng(1234);
+
+Bytes random_bytes(size_t n, int alphabet = 256) {
+    Bytes out(n);
+    for (uint8_t& b : out) b = static_cast<uint8_t>(rng() % alphabet);
+    return out;
+}
+
+Bytes concat(std::initializer_list<Bytes> parts) {
+    Bytes out;
+    for (const Bytes& p : parts) out.insert(out.end(), p.begin(), p.end());
+    return out;
+}
+
+Bytes slice(const Bytes& b, size_t begin, size_t end) {
+    return Bytes(b.begin() + begin, b.begin() + end);
+}
+
+// Returns the patch size, or SIZE_MAX if the round trip failed.
+size_t round_trip(const Bytes& source, const Bytes& target) {
+    Bytes patch = bps::create(source.data(), source.size(), target.data(), target.size());
+    Bytes result = bps::apply(source.data(), source.size(), patch.data(), patch.size());
+    return result == target ? patch.size() : SIZE_MAX;
+}
+
+void test_suffix_array() {
+    for (size_t n : {0, 1, 2, 3, 17, 100, 1000, 5000}) {
+        for (int alphabet : {1, 2, 4, 256}) {
+            Bytes text = random_bytes(n, alphabet);
+            std::vector<int32_t> expected(n);
+            std::iota(expected.begin(), expected.end(), 0);
+            std::sort(expected.begin(), expected.end(), [&](int32_t a, int32_t b) {
+                return std::lexicographical_compare(text.begin() + a, text.end(),
+                                                    text.begin() + b, text.end());
+            });
+            CHECK(build_suffix_array(text.data(), text.size()) == expected);
+        }
+    }
+}
+
+void test_round_trips() {
+    const Bytes empty;
+    const Bytes rom = random_bytes(1 << 20);
+    CHECK(round_trip(empty, empty) != SIZE_MAX);
+    CHECK(round_trip(empty, rom) != SIZE_MAX);
+    CHECK(round_trip(rom, empty) != SIZE_MAX);
+    CHECK(round_trip(rom, rom) < 64);
+    CHECK(round_trip(rom, slice(rom, 0, rom.size() - 3)) < 64);
+    CHECK(round_trip(slice(rom, 0, 5), slice(rom, 0, 7)) != SIZE_MAX);
+
+    Bytes edited = rom;
+    for (size_t off = 1000; off < edited.size(); off += 50000) {
+        std::fill(edited.begin() + off, edited.begin() + off + 20, 0x41);
+    }
+    CHECK(round_trip(rom, edited) < 1000);
+
+    // One bank shrinks by 200 bytes and a later one grows by 300: only the
+    // 300 new bytes should be stored.
+    Bytes banks = concat({slice(rom, 0, 200000), slice(rom, 200200, 600000),
+                          random_bytes(300), slice(rom, 600000, rom.size())});
+    CHECK(round_trip(rom, banks) < 450);
+
+    // A block moved to another part of the image.
+    Bytes moved = rom;
+    std::copy(rom.begin() + 100000, rom.begin() + 150000, moved.begin() + 800000);
+    CHECK(round_trip(rom, moved) < 100);
+
+    // Unrelated data round-trips at about its own size.
+    Bytes other = random_bytes(rom.size());
+    CHECK(round_trip(rom, other) < other.size() + 64);
+}
+
+void test_text_edits() {
+    // Low-entropy, repetitive data like decoded text: anchors and short
+    // matches hit many candidates.
+    Bytes text = random_bytes(300000, 8);
+    Bytes edited = concat({slice(text, 0, 50000), random_bytes(40, 8), slice(text, 50010, 250000),
+                           slice(text, 10000, 10100), slice(text, 250000, text.size())});
+    CHECK(round_trip(text, edited) < 400);
+}
+
+void test_random_edits() {
+    for (int i = 0; i < 200; i++) {
+        Bytes source = random_bytes(rng() % 4000, i % 2 ? 4 : 256);
+        Bytes target = source;
+        for (int edits = rng() % 6; edits > 0; edits--) {
+            size_t at = target.empty() ? 0 : rng() % target.size();
+            switch (rng() % 3) {
+            case 0: {
+                Bytes ins = random_bytes(rng() % 200, 4);
+                target.insert(target.begin() + at, ins.begin(), ins.end());
+                break;
+            }
+            case 1:
+                target.erase(target.begin() + at, target.begin() + std::min(target.size(), at + rng() % 200));
+                break;
+            default:
+                if (at < target.size()) target[at] ^= 0x5A;
+                break;
+            }
+        }
+        CHECK(round_trip(source, target) != SIZE_MAX);
+    }
+}
+
+Bytes finish_patch(Bytes patch, const Bytes& source, const Bytes& target) {
+    put_le(patch, crc32(source.data(), source.size()), 4);
+    put_le(patch, crc32(target.data(), target.size()), 4);
+    put_le(patch, crc32(patch.data(), patch.size()), 4);
+    return patch;
+}
+
+void test_apply() {
+    // create() never emits TargetCopy; build one by hand. Sizes 0 and 6,
+    // no metadata, TargetRead "ab", then TargetCopy of 4 bytes from offset
+    // 0, overlapping what it writes.
+    const Bytes empty;
+    const Bytes ababab = {'a', 'b', 'a', 'b', 'a', 'b'};
+    Bytes patch = finish_patch({'B', 'P', 'S', '1', 0x80, 0x86, 0x80, 0x80 | (1 << 2) | 1, 'a', 'b',
+                                0x80 | (3 << 2) | 3, 0x80}, empty, ababab);
+    CHECK(bps::apply(nullptr, 0, patch.data(), patch.size()) == ababab);
+
+    const Bytes source = random_bytes(10000);
+    Bytes target = source;
+    target[5000] ^= 1;
+    Bytes good = bps::create(source.data(), source.size(), target.data(), target.size(), "meta");
+
+    auto rejects = [](const Bytes& src, const Bytes& p) {
+        try {
+            bps::apply(src.data(), src.size(), p.data(), p.size());
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    Bytes corrupt = good;
+    corrupt[corrupt.size() / 2] ^= 1;
+    CHECK(rejects(source, corrupt));
+    Bytes wrong_source = source;
+    wrong_source[0] ^= 1;
+    CHECK(rejects(wrong_source, good));
+    CHECK(rejects(slice(source, 0, 9999), good));
+    CHECK(rejects(source, slice(good, 0, 10)));
+}
+
+}
+
+int main() {
+    test_suffix_array();
+    test_round_trips();
+    test_text_edits();
+    test_random_edits();
+    test_apply();
+    return check_result();
+}
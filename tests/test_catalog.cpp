@@ -0,0 +1,142 @@
+//
+//  test_catalog.cpp
+//  poketext-gen4 tests
+//
+
+#include "check.hpp"
+
+#include "catalog.hpp"
+#include "checksum.hpp"
+#include "file_io.hpp"
+#include "nds_header.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+using Bytes = std::vector<uint8_t>;
+
+constexpr size_t kBanner = 0x200;
+
+// A header with a valid checksum, followed by a version 1 banner with
+// `title` in every language.
+Bytes make_rom(const char* game_code, uint8_t revision, const std::u16string& title) {
+    Bytes rom(kBanner + 0x840);
+    std::memcpy(&rom[0], "POKEMON D", 9);
+    std::memcpy(&rom[0x0C], game_code, 4);
+    std::memcpy(&rom[0x10], "01", 2);
+    rom[0x1E] = revision;
+    rom[0x68] = static_cast<uint8_t>(kBanner);
+    rom[0x69] = static_cast<uint8_t>(kBanner >> 8);
+    const uint16_t header_crc = crc16(rom.data(), 0x15E);
+    rom[0x15E] = static_cast<uint8_t>(header_crc);
+    rom[0x15F] = static_cast<uint8_t>(header_crc >> 8);
+
+    uint8_t* banner = &rom[kBanner];
+    banner[0] = 1;
+    for (size_t lang = 0; lang < 6; lang++) {
+        for (size_t i = 0; i < title.size(); i++) {
+            banner[0x240 + lang * 0x100 + 2 * i] = static_cast<uint8_t>(title[i]);
+            banner[0x240 + lang * 0x100 + 2 * i + 1] = static_cast<uint8_t>(title[i] >> 8);
+        }
+    }
+    const uint16_t banner_crc = crc16(banner + 0x20, 0x840 - 0x20);
+    banner[2] = static_cast<uint8_t>(banner_crc);
+    banner[3] = static_cast<uint8_t>(banner_crc >> 8);
+    return rom;
+}
+
+void test_header_and_banner() {
+    const Bytes rom = make_rom("ADAE", 2, u"Pokémon Diamond\nNintendo \U0001F48E");
+    auto header = parse_nds_header(rom.data(), rom.size());
+    CHECK(header);
+    if (!header) return;
+    CHECK(header->title == "POKEMON D");
+    CHECK(header->game_code == "ADAE");
+    CHECK(header->maker_code == "01");
+    CHECK(header->revision == 2);
+    CHECK(header->banner_offset == kBanner);
+    CHECK(nds_region(header->game_code) == "USA");
+
+    auto banner = parse_nds_banner(rom.data() + kBanner, rom.size() - kBanner);
+    CHECK(banner);
+    if (!banner) return;
+    CHECK(banner->version == 1);
+    CHECK(banner->titles[1] == "Pok\xC3\xA9mon Diamond\nNintendo \xF0\x9F\x92\x8E");
+    CHECK(banner->titles[6].empty());
+
+    Bytes bad = rom;
+    bad[0x0C] ^= 1;
+    CHECK(!parse_nds_header(bad.data(), bad.size()));
+    bad = rom;
+    bad[kBanner + 0x240] ^= 1;
+    CHECK(!parse_nds_banner(bad.data() + kBanner, bad.size() - kBanner));
+}
+
+void write_rom(const fs::path& path, const Bytes& rom) {
+    write_file(path.string(), rom.data(), rom.size());
+}
+
+void test_scan() {
+    const fs::path root = fs::temp_directory_path() / "poketext-test-catalog";
+    fs::remove_all(root);
+    fs::create_directories(root / "sub");
+    write_rom(root / "d.nds", make_rom("ADAE", 0, u"Diamond"));
+    write_rom(root / "sub" / "tab\tname.nds", make_rom("APAF", 1, u"Perle\tPearl\nLine two\\"));
+    const std::string junk = "not a rom";
+    write_file((root / "junk.nds").string(), reinterpret_cast<const uint8_t*>(junk.data()), junk.size());
+
+    Catalog catalog;
+    Catalog::ScanStats stats = catalog.scan(root.string());
+    CHECK(stats.files == 3);
+    CHECK(stats.reread == 3);
+    CHECK(catalog.entries().size() == 3);
+
+    // Saved and loaded, tabs, newlines and backslashes survive.
+    const std::string index = (root / "index").string();
+    catalog.save(index);
+    Catalog loaded = Catalog::load(index);
+    CHECK(loaded.entries().size() == catalog.entries().size());
+    for (size_t i = 0; i < loaded.entries().size() && i < catalog.entries().size(); i++) {
+        const Catalog::Entry& a = catalog.entries()[i];
+        const Catalog::Entry& b = loaded.entries()[i];
+        CHECK(a.path == b.path);
+        CHECK(a.size == b.size);
+        CHECK(a.mtime == b.mtime);
+        CHECK(a.is_rom == b.is_rom);
+        CHECK(a.game_code == b.game_code);
+        CHECK(a.revision == b.revision);
+        CHECK(a.titles == b.titles);
+    }
+    CHECK(loaded.entries().size() == 3 && loaded.entries()[2].path == "sub/tab\tname.nds");
+    CHECK(loaded.entries().size() == 3 && loaded.entries()[2].titles[0] == "Perle\tPearl\nLine two\\");
+
+    // Unchanged files are not read again; a touched one is.
+    stats = loaded.scan(root.string());
+    CHECK(stats.files == 3);
+    CHECK(stats.reread == 0);
+    const fs::path d = root / "d.nds";
+    fs::last_write_time(d, fs::last_write_time(d) + std::chrono::seconds(5));
+    stats = loaded.scan(root.string());
+    CHECK(stats.reread == 1);
+
+    fs::remove(root / "junk.nds");
+    stats = loaded.scan(root.string());
+    CHECK(stats.files == 2);
+    CHECK(stats.reread == 0);
+    fs::remove_all(root);
+}
+
+}
+
+int main() {
+    test_header_and_banner();
+    test_scan();
+    return check_result();
+}
@@ -0,0 +1,97 @@
+//
+//  test_commands.cpp
+//  poketext-gen4 tests
+//
+
+#include "check.hpp"
+#include "zip_fixture.hpp"
+
+#include "commands.hpp"
+#include "file_io.hpp"
+#include "session.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+std::string run(Session& session, const std::string& commands) {
+    std::istringstream in(commands);
+    std::ostringstream out;
+    run_pipe(session, in, out);
+    return out.str();
+}
+
+size_t count(const std::string& text, const std::string& what) {
+    size_t n = 0;
+    for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1)) n++;
+    return n;
+}
+
+void test_split_command() {
+    CHECK(split_command("") == Args{});
+    CHECK(split_command("  \t ") == Args{});
+    CHECK((split_command(" fingerprint  a.nds\tb.nds ") == Args{"fingerprint", "a.nds", "b.nds"}));
+    CHECK((split_command("x \"My Games/a b.nds\" c") == Args{"x", "My Games/a b.nds", "c"}));
+    CHECK((split_command("x \"\"") == Args{"x", ""}));
+    CHECK((split_command("pre\"fix\"ed") == Args{"prefixed"}));
+    CHECK((split_command("\"a \\\"quote\\\" and \\\\\"") == Args{"a \"quote\" and \\"}));
+    // Backslash is only an escape inside quotes.
+    CHECK((split_command("C:\\roms\\a.nds") == Args{"C:\\roms\\a.nds"}));
+    bool rejected = false;
+    try {
+        split_command("x \"open");
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+}
+
+void test_pipe_lines() {
+    Session session(Session::kPipeRoms);
+    // Comments are skipped whatever they contain; blank lines too.
+    CHECK(run(session, "# a \"stray quote\n   # indented\n\n  \t\n") == "");
+    CHECK(run(session, "nonsense\n") == "error: unknown command 'nonsense'\nend 1\n");
+    CHECK(run(session, "pipe\n") == "error: unknown command 'pipe'\nend 1\n");
+    CHECK(run(session, "similar x\n") == "error: usage: similar <index> <rom>\nend 1\n");
+    CHECK(run(session, "x \"open\n") == "error: unterminated quote\nend 1\n");
+}
+
+void test_corrupt_zip_stays_failed() {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "poketext-test-commands";
+    fs::create_directories(dir);
+    const std::string zip_path = (dir / "bad.zip").string();
+    Bytes rom(200000);
+    for (size_t i = 0; i < rom.size(); i++) rom[i] = static_cast<uint8_t>(i * 7 + (i >> 9));
+    Bytes zip = make_zip("game.nds", rom, deflate_stored(rom), 8);
+    zip[central_crc_offset(zip, "game.nds")] ^= 1;
+    write_file(zip_path, zip.data(), zip.size());
+
+    // The image stays cached after the first failure; later commands in the
+    // session must see the same error instead of the unchecked bytes.
+    Session session(Session::kPipeRoms);
+    const std::string patch = (dir / "o.bps").string();
+    const std::string out = run(session, "bps-create " + zip_path + " " + zip_path + " " + patch + "\n"
+                                         "bps-create " + zip_path + " " + zip_path + " " + patch + "\n"
+                                         "fingerprint " + zip_path + "\n");
+    CHECK(count(out, "CRC mismatch") == 3);
+    CHECK(count(out, "end 1\n") == 3);
+    CHECK(!fs::exists(patch));
+    fs::remove_all(dir);
+}
+
+}
+
+int main() {
+    test_split_command();
+    test_pipe_lines();
+    test_corrupt_zip_stays_failed();
+    return check_result();
+}
@@ -0,0 +1,70 @@
+//
+//  test_fingerprint.cpp
+//  poketext-gen4 tests
+//
+
+#include "check.hpp"
+
+#include "fingerprint.hpp"
+
+#include <random>
+#include <vector>
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+using Ranges = std::vector<std::pair<uint64_t, uint64_t>>;
+
+constexpr uint32_t kChunk = 4096;
+
+Fingerprint fingerprint(const Bytes& b) {
+    return Fingerprint(b.data(), b.size(), kChunk);
+}
+
+void test_compare() {
+    std::mt19937 rng(7);
+    Bytes rom(kChunk * 10 + 100);
+    for (uint8_t& b : rom) b = static_cast<uint8_t>(rng());
+    const Fingerprint base = fingerprint(rom);
+
+    CHECK(fingerprint(rom).root() == base.root());
+    CHECK(base.changed_ranges(fingerprint(rom)).empty());
+
+    Bytes edited = rom;
+    edited[kChunk * 3 + 5] ^= 1;
+    edited[kChunk * 4] ^= 1;
+    CHECK(fingerprint(edited).root() != base.root());
+    CHECK(base.changed_ranges(fingerprint(edited)) == (Ranges{{kChunk * 3, kChunk * 5}}));
+
+    // Cut at a chunk boundary: no chunk of the shorter image differs, but
+    // the roots must.
+    Bytes cut(rom.begin(), rom.begin() + kChunk * 8);
+    CHECK(fingerprint(cut).root() != base.root());
+    CHECK(base.changed_ranges(fingerprint(cut)).empty());
+
+    const Bytes empty;
+    CHECK(fingerprint(empty).root() != base.root());
+
+    Bytes grown = rom;
+    grown.resize(rom.size() + kChunk * 2, 0xFF);
+    CHECK(base.changed_ranges(fingerprint(grown)) == (Ranges{{kChunk * 10, grown.size()}}));
+}
+
+void test_save_load() {
+    Bytes rom(kChunk * 3 + 1, 0x5A);
+    const Fingerprint fp = fingerprint(rom);
+    std::vector<uint8_t> bytes = fp.save();
+    CHECK(Fingerprint::is_fingerprint_file(bytes.data(), bytes.size()));
+    const Fingerprint loaded = Fingerprint::load(bytes.data(), bytes.size());
+    CHECK(loaded.root() == fp.root());
+    CHECK(loaded.size() == fp.size());
+    CHECK(loaded.chunks().size() == 4);
+}
+
+}
+
+int main() {
+    test_compare();
+    test_save_load();
+    return check_result();
+}
@@ -0,0 +1,146 @@
+//
+//  test_inflate.cpp
+//  poketext-gen4 tests
+//
+
+#include "check.hpp"
+#include "zip_fixture.hpp"
+
+#include "file_io.hpp"
+#include "inflate.hpp"
+#include "rom_image.hpp"
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+std::mt19937 rng(99);
+
+// Raw DEFLATE through zlib, as zip archives store it.
+Bytes deflate_raw(const Bytes& data, int level, int strategy) {
+    z_stream z{};
+    CHECK(deflateInit2(&z, level, Z_DEFLATED, -15, 8, strategy) == Z_OK);
+    Bytes out(deflateBound(&z, data.size()));
+    z.next_in = const_cast<Bytes::value_type*>(data.data());
+    z.avail_in = static_cast<uInt>(data.size());
+    z.next_out = out.data();
+    z.avail_out = static_cast<uInt>(out.size());
+    CHECK(deflate(&z, Z_FINISH) == Z_STREAM_END);
+    out.resize(z.total_out);
+    deflateEnd(&z);
+    return out;
+}
+
+// Mixes runs, a small alphabet and random bytes, so every block type and
+// both the paired-literal and long-code paths are exercised.
+Bytes sample(size_t n) {
+    Bytes out;
+    while (out.size() < n) {
+        switch (rng() % 3) {
+        case 0:
+            out.insert(out.end(), rng() % 300, static_cast<uint8_t>(rng()));
+            break;
+        case 1:
+            for (int i = rng() % 500; i > 0; i--) out.push_back("etaoin shrdlu"[rng() % 13]);
+            break;
+        default:
+            for (int i = rng() % 200; i > 0; i--) out.push_back(static_cast<uint8_t>(rng()));
+            break;
+        }
+    }
+    out.resize(n);
+    return out;
+}
+
+void test_against_zlib() {
+    for (size_t n : {0, 1, 100, 70000, 1 << 20}) {
+        const Bytes data = sample(n);
+        for (int level : {0, 1, 6, 9}) {
+            for (int strategy : {Z_DEFAULT_STRATEGY, Z_FIXED, Z_HUFFMAN_ONLY, Z_RLE}) {
+                const Bytes packed = deflate_raw(data, level, strategy);
+                Bytes out(data.size());
+                Inflater inflater(packed.data(), packed.size(), out.data(), out.size());
+                // Resume in uneven steps, as RomImage::prefix does.
+                size_t have = 0;
+                for (size_t want = 1; have < out.size(); want = want * 3 + 7) {
+                    have = inflater.inflate_until(want);
+                }
+                CHECK(have == data.size());
+                CHECK(out == data);
+            }
+        }
+    }
+}
+
+void test_corrupt_input() {
+    const Bytes data = sample(50000);
+    const Bytes packed = deflate_raw(data, 6, Z_DEFAULT_STRATEGY);
+    auto rejects = [&](const Bytes& in) {
+        Bytes out(data.size());
+        try {
+            Inflater(in.data(), in.size(), out.data(), out.size()).inflate_until(out.size());
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    CHECK(rejects(Bytes(packed.begin(), packed.begin() + packed.size() / 2)));
+    CHECK(rejects(Bytes{0xFF, 0xFF, 0xFF, 0xFF}));
+}
+
+void test_zipped_rom() {
+    const std::string path = (std::filesystem::temp_directory_path() / "poketext-test.zip").string();
+    const Bytes rom = sample(300000);
+    for (bool deflated : {false, true}) {
+        const Bytes zip = deflated ? make_zip("Game (E).NDS", rom, deflate_raw(rom, 6, Z_DEFAULT_STRATEGY), 8)
+                                   : make_zip("Game (E).NDS", rom, rom, 0);
+        write_file(path, zip.data(), zip.size());
+        RomImage image(path);
+        CHECK(image.size() == rom.size());
+        CHECK(std::memcmp(image.prefix(0x200), rom.data(), 0x200) == 0);
+        CHECK(std::memcmp(image.data(), rom.data(), rom.size()) == 0);
+    }
+
+    // A member whose CRC does not match is rejected once fully read, stored
+    // or deflated. The CRC checked is the central directory's.
+    const std::string name = "game.nds";
+    for (bool deflated : {false, true}) {
+        Bytes zip = deflated ? make_zip(name, rom, deflate_raw(rom, 6, Z_DEFAULT_STRATEGY), 8)
+                             : make_zip(name, rom, rom, 0);
+        zip[central_crc_offset(zip, name)] ^= 1;
+        write_file(path, zip.data(), zip.size());
+        RomImage image(path);
+        auto rejects = [&] {
+            try {
+                image.data();
+            } catch (const std::runtime_error&) {
+                return true;
+            }
+            return false;
+        };
+        CHECK(std::memcmp(image.prefix(0x200), rom.data(), 0x200) == 0);
+        CHECK(rejects());
+        // Asking again must not hand out the unchecked bytes.
+        CHECK(rejects());
+    }
+    std::remove(path.c_str());
+}
+
+}
+
+int main() {
+    test_against_zlib();
+    test_corrupt_input();
+    test_zipped_rom();
+    return check_result();
+}
@@ -0,0 +1,110 @@
+//
+//  test_minhash.cpp
+//  poketext-gen4 tests
+//
+
+#include "check.hpp"
+
+#include "minhash.hpp"
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+std::mt19937 rng(2024);
+
+Bytes random_bytes(size_t n) {
+    Bytes out(n);
+    for (uint8_t& b : out) b = static_cast<uint8_t>(rng());
+    return out;
+}
+
+minhash::Entry entry(const std::string& path, const Bytes& data) {
+    minhash::Entry e;
+    e.path = path;
+    e.is_rom = true;
+    e.game_code = "ADAE";
+    e.size = data.size();
+    e.signature = minhash::signature(data.data(), data.size());
+    return e;
+}
+
+void test_save_load() {
+    minhash::Index index;
+    // Longer than a one-byte length could hold.
+    minhash::Entry a = entry(std::string(300, 'd') + "/a.nds", random_bytes(5000));
+    a.revision = 3;
+    a.mtime = -1234567890123;
+    minhash::Entry b = entry("b.zip", random_bytes(7));
+    b.game_code = "CPUE";
+    b.mtime = 42;
+    index.add(a);
+    index.add(b);
+
+    const Bytes bytes = index.save();
+    const minhash::Index loaded = minhash::Index::load(bytes.data(), bytes.size());
+    CHECK(loaded.size() == 2);
+    for (size_t i = 0; i < 2 && i < loaded.size(); i++) {
+        const minhash::Entry& want = index.entries()[i];
+        const minhash::Entry& got = loaded.entries()[i];
+        CHECK(got.path == want.path);
+        CHECK(got.is_rom);
+        CHECK(got.game_code == want.game_code);
+        CHECK(got.revision == want.revision);
+        CHECK(got.size == want.size);
+        CHECK(got.mtime == want.mtime);
+        CHECK(got.signature == want.signature);
+    }
+    CHECK(loaded.save() == bytes);
+
+    auto rejects = [](Bytes data) {
+        try {
+            minhash::Index::load(data.data(), data.size());
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    CHECK(rejects(Bytes(bytes.begin(), bytes.end() - 1)));
+    Bytes old_version = bytes;
+    old_version[4] = 2;
+    CHECK(rejects(old_version));
+    Bytes bad_magic = bytes;
+    bad_magic[0] = 'X';
+    CHECK(rejects(bad_magic));
+}
+
+void test_ranking() {
+    const Bytes base = random_bytes(1 << 20);
+    Bytes near = base;
+    for (size_t off = 4096; off < near.size(); off += 65536) near[off] ^= 0xFF;
+    const Bytes unrelated = random_bytes(base.size());
+
+    minhash::Index index;
+    index.add(entry("unrelated.nds", unrelated));
+    index.add(entry("near.nds", near));
+    const minhash::Signature query = minhash::signature(base.data(), base.size());
+    const std::vector<minhash::Match> matches = index.query(query, 5);
+    CHECK(!matches.empty());
+    if (!matches.empty()) {
+        CHECK(matches[0].entry->path == "near.nds");
+        CHECK(matches[0].similarity > 0.9);
+    }
+    for (const minhash::Match& m : matches) {
+        if (m.entry->path == "unrelated.nds") CHECK(m.similarity < 0.1);
+    }
+    CHECK(index.query(query, 1).size() <= 1);
+}
+
+}
+
+int main() {
+    test_save_load();
+    test_ranking();
+    return check_result();
+}
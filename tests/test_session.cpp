@@ -0,0 +1,109 @@
+//
+//  test_session.cpp
+//  poketext-gen4 tests
+//
+
+#include "check.hpp"
+
+#include "file_io.hpp"
+#include "session.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+void put(const fs::path& path, const std::string& text) {
+    write_file(path.string(), reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+// A cache of file contents that counts how often it reads a file.
+struct Reader {
+    int loads = 0;
+    std::shared_ptr<std::string> operator()(const std::string& path) {
+        loads++;
+        MappedFile file(path);
+        return std::make_shared<std::string>(reinterpret_cast<const char*>(file.data()), file.size());
+    }
+};
+
+void test_invalidation() {
+    const fs::path dir = fs::temp_directory_path() / "poketext-test-session";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const std::string path = (dir / "a").string();
+    FileCache<std::string> cache(4);
+    Reader reader;
+    auto load = [&](const std::string& p) { return reader(p); };
+
+    put(path, "first");
+    CHECK(*cache.get(path, load) == "first");
+    CHECK(*cache.get(path, load) == "first");
+    CHECK(reader.loads == 1);
+    CHECK(cache.find(path) && *cache.find(path) == "first");
+
+    // A different size is noticed even if the mtime did not tick.
+    const auto mtime = fs::last_write_time(path);
+    put(path, "second!");
+    fs::last_write_time(path, mtime);
+    CHECK(!cache.find(path));
+    CHECK(*cache.get(path, load) == "second!");
+    CHECK(reader.loads == 2);
+
+    // So is a new mtime with the same size.
+    put(path, "third!!");
+    fs::last_write_time(path, mtime + std::chrono::seconds(5));
+    CHECK(!cache.find(path));
+    CHECK(*cache.get(path, load) == "third!!");
+    CHECK(reader.loads == 3);
+
+    // A value already handed out outlives its entry.
+    std::shared_ptr<std::string> held = cache.get(path, load);
+    fs::remove(path);
+    CHECK(!cache.find(path));
+    CHECK(*held == "third!!");
+    fs::remove_all(dir);
+}
+
+void test_eviction() {
+    const fs::path dir = fs::temp_directory_path() / "poketext-test-session";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const std::string a = (dir / "a").string(), b = (dir / "b").string(), c = (dir / "c").string();
+    put(a, "a");
+    put(b, "b");
+    put(c, "c");
+    Reader reader;
+    auto load = [&](const std::string& p) { return reader(p); };
+
+    // The least recently used entry goes first: a was used after b.
+    FileCache<std::string> cache(2);
+    cache.get(a, load);
+    cache.get(b, load);
+    cache.get(a, load);
+    cache.get(c, load);
+    CHECK(reader.loads == 3);
+    CHECK(cache.find(a));
+    CHECK(!cache.find(b));
+    CHECK(cache.find(c));
+
+    // A capacity of 0 loads every time and keeps nothing.
+    FileCache<std::string> none(0);
+    none.get(a, load);
+    none.get(a, load);
+    CHECK(reader.loads == 5);
+    CHECK(!none.find(a));
+    fs::remove_all(dir);
+}
+
+}
+
+int main() {
+    test_invalidation();
+    test_eviction();
+    return check_result();
+}
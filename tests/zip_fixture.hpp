@@ -0,0 +1,77 @@
+//
+//  zip_fixture.hpp
+//  poketext-gen4 tests
+//
+
+#ifndef zip_fixture_hpp
+#define zip_fixture_hpp
+
+#include "byte_order.hpp"
+#include "checksum.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A one-member archive with no extra fields or comments. `body` is the
+// member as stored: `data` itself for method 0, its raw DEFLATE stream for
+// method 8. The CRC recorded is that of `data`.
+inline std::vector<uint8_t> make_zip(const std::string& name, const std::vector<uint8_t>& data,
+                                     const std::vector<uint8_t>& body, uint16_t method) {
+    const uint32_t crc = crc32(data.data(), data.size());
+    std::vector<uint8_t> zip;
+    put_le(zip, 0x04034B50, 4);
+    for (uint32_t v : {20u, 0u, uint32_t(method), 0u, 0u}) put_le(zip, v, 2);
+    put_le(zip, crc, 4);
+    put_le(zip, body.size(), 4);
+    put_le(zip, data.size(), 4);
+    put_le(zip, name.size(), 2);
+    put_le(zip, 0, 2);
+    zip.insert(zip.end(), name.begin(), name.end());
+    zip.insert(zip.end(), body.begin(), body.end());
+
+    const uint32_t directory = static_cast<uint32_t>(zip.size());
+    put_le(zip, 0x02014B50, 4);
+    for (uint32_t v : {20u, 20u, 0u, uint32_t(method), 0u, 0u}) put_le(zip, v, 2);
+    put_le(zip, crc, 4);
+    put_le(zip, body.size(), 4);
+    put_le(zip, data.size(), 4);
+    put_le(zip, name.size(), 2);
+    for (int i = 0; i < 4; i++) put_le(zip, 0, 2);
+    put_le(zip, 0, 4);
+    put_le(zip, 0, 4);
+    zip.insert(zip.end(), name.begin(), name.end());
+    const uint32_t directory_size = static_cast<uint32_t>(zip.size()) - directory;
+
+    put_le(zip, 0x06054B50, 4);
+    for (uint32_t v : {0u, 0u, 1u, 1u}) put_le(zip, v, 2);
+    put_le(zip, directory_size, 4);
+    put_le(zip, directory, 4);
+    put_le(zip, 0, 2);
+    return zip;
+}
+
+// Offset of the central directory's CRC in an archive from make_zip():
+// 16 bytes into the entry, which sits before the 22-byte end record.
+inline size_t central_crc_offset(const std::vector<uint8_t>& zip, const std::string& name) {
+    return zip.size() - 22 - (46 + name.size()) + 16;
+}
+
+// A DEFLATE stream of uncompressed blocks, for deflated members built
+// without a compressor.
+inline std::vector<uint8_t> deflate_stored(const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> out;
+    size_t pos = 0;
+    do {
+        const size_t n = std::min<size_t>(data.size() - pos, 0xFFFF);
+        out.push_back(pos + n == data.size() ? 1 : 0);
+        put_le(out, n, 2);
+        put_le(out, ~n & 0xFFFF, 2);
+        out.insert(out.end(), data.begin() + pos, data.begin() + pos + n);
+        pos += n;
+    } while (pos < data.size());
+    return out;
+}
+
+#endif /* zip_fixture_hpp */